@@ -0,0 +1,63 @@
+#!/usr/bin/env python
+
+import cppcheckdata
+
+
+# FIELDS THE ANALYSIS ADDS TO cppcheck OBJECTS  (SEE ConstraintCollector.init_cppcheck_config_data_structures)
+TOKEN_ANALYSIS_FIELDS = cppcheckdata.ANALYSIS_TOKEN_FIELDS
+FUNCTION_ANALYSIS_FIELDS = ('return_units', 'arg_units', 'return_arg_var_nr', 'return_expr_root_token',
+                            'is_unit_propagation_based_on_constants',
+                            'is_unit_propagation_based_on_unknown_variable',
+                            'is_unit_propagation_based_on_weak_inference',
+                            'maybe_generic_function')
+
+
+class AnalysisState:
+    ''' SNAPSHOT OF THE ANALYSIS FIELDS OF EVERY TOKEN AND FUNCTION OF A PARSED Configuration.
+        THE PARSED STRUCTURE (AST LINKS, SCOPES, VARIABLES) IS SHARED AND NEVER CHANGES, SO A PASS THAT
+        NEEDS ITS OWN UNITS CAN RUN ON THE SAME OBJECTS BETWEEN fork() AND restore(), INSTEAD OF ON A
+        FRESH PARSE OF THE DUMP.
+        ONLY REFERENCES ARE SAVED:  fork() GIVES EVERY TOKEN AND FUNCTION NEW UNIT LISTS, SO THE PASS
+        NEVER MUTATES A SAVED LIST
+        '''
+
+    def __init__(self, cppcheck_configuration):
+        self.configuration = cppcheck_configuration
+        self.token_fields = [tuple(getattr(t, name, None) for name in TOKEN_ANALYSIS_FIELDS)
+                             for t in cppcheck_configuration.tokenlist]
+        self.function_fields = [tuple(getattr(f, name, None) for name in FUNCTION_ANALYSIS_FIELDS)
+                                for f in cppcheck_configuration.functions]
+
+
+    def fork(self):
+        ''' START A PASS FROM THE STATE OF A FRESH PARSE, KEEPING isRoot AND isDimensionless OF THE TOKENS
+            AND EVERYTHING BUT THE UNITS OF THE FUNCTIONS
+            '''
+        for t in self.configuration.tokenlist:
+            t.units = []
+            t.isKnown = False
+            t.is_unit_propagation_based_on_constants = False
+            t.is_unit_propagation_based_on_unknown_variable = False
+            t.is_unit_propagation_based_on_weak_inference = False
+        for f in self.configuration.functions:
+            f.return_units = []
+            f.arg_units = [[] for arg_number in f.argument.keys()]
+
+
+    def restore(self):
+        for (t, fields) in zip(self.configuration.tokenlist, self.token_fields):
+            for (name, value) in zip(TOKEN_ANALYSIS_FIELDS, fields):
+                setattr(t, name, value)
+        for (f, fields) in zip(self.configuration.functions, self.function_fields):
+            for (name, value) in zip(FUNCTION_ANALYSIS_FIELDS, fields):
+                setattr(f, name, value)
+
+
+def get_token_index(cppcheck_configuration):
+    ''' returns: {token Id: token}, BUILT ONCE PER Configuration
+        '''
+    index = getattr(cppcheck_configuration, 'id2token', None)
+    if index is None:
+        index = {t.Id: t for t in cppcheck_configuration.tokenlist}
+        cppcheck_configuration.id2token = index
+    return index
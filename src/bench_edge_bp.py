@@ -0,0 +1,98 @@
+#!/usr/bin/env python
+# BENCHMARK OF THE EDGE-ARRAY BP BACKEND (pgm/edge_bp.py) AGAINST libDAI (pgm.PGMEngine).
+# ANALYZES FILES OF data/ AS prob_phys_units.py DOES, AND SOLVES EVERY LOOPY COMPONENT OF EVERY SOLVE ROUND
+# WITH BOTH ENGINES, COLD (NO WARM START), ON THE SAME FACTORS.  THE ANALYSIS CONTINUES WITH THE libDAI
+# MARGINALS.  NEEDS cppcheck AND THE libDAI BINDINGS.  RUN FROM src/:
+#     python bench_edge_bp.py [source files, default: DEFAULT_BENCHMARK_FILES]
+
+from __future__ import print_function
+import os
+import sys
+from time import time
+from datamining2 import TypeMiner
+from pgm.pgm import PGMEngine, is_dai_available
+from pgm.edge_bp import EdgeBPEngine
+from pgm.pgmplayer import PGMPlayer
+import cps_constraints as con
+import prob_phys_units
+
+
+DEFAULT_BENCHMARK_FILES = [
+        '../data/AutoNavQuad/quad_control/src/nodes/attitude_controller_node.cpp',
+        '../data/AutoNavQuad/quad_control/src/nodes/position_controller_node.cpp',
+        ]
+
+# A MARGINAL IS ON THE OTHER SIDE OF THIS PROBABILITY IN THE TWO ENGINES:  THE UNIT DECISION DIFFERS
+DECISION_THRESHOLD = prob_phys_units.PROB_THRESH
+
+# ONE ROW PER LOOPY COMPONENT:  (vars, factors, libDAI seconds, edge seconds, max |p0 diff|, decisions that differ)
+benchmark_rows = []
+
+
+def run_both_engines(player, factors, alg, fg_filename=None):
+    ''' REPLACES PGMPlayer._run_inference:  TIME BOTH ENGINES ON factors, RECORD HOW FAR THEIR MARGINALS ARE
+        returns: {pgm var: p0} OF libDAI
+        '''
+    component_memo = player.component_memo
+    player.component_memo = None
+    try:
+        start = time()
+        dai_marginals = player._compute_marginals_with_engine(PGMEngine, factors, alg, fg_filename)
+        dai_seconds = time() - start
+        if not EdgeBPEngine.supports(factors):
+            return dai_marginals
+        start = time()
+        edge_marginals = player._compute_marginals_with_engine(EdgeBPEngine, factors, alg)
+        edge_seconds = time() - start
+    finally:
+        player.component_memo = component_memo
+
+    diffs = [abs(dai_marginals[pv] - edge_marginals[pv]) for pv in dai_marginals]
+    nr_decisions = sum(1 for pv in dai_marginals
+                       if (dai_marginals[pv] < DECISION_THRESHOLD) != (edge_marginals[pv] < DECISION_THRESHOLD))
+    benchmark_rows.append((len(dai_marginals), len(factors), dai_seconds, edge_seconds,
+                           max(diffs or [0.0]), nr_decisions))
+    return dai_marginals
+
+
+def print_benchmark(target_cpp_file, rows):
+    print('%s:  %d loopy components' % (target_cpp_file, len(rows)))
+    if not rows:
+        return
+    print('%8s %8s %10s %10s %12s %10s' % ('vars', 'factors', 'libDAI s', 'edge s', 'max |dp0|', 'decisions'))
+    for row in rows:
+        print('%8d %8d %10.4f %10.4f %12.2e %10d' % row)
+    print('%8d %8d %10.4f %10.4f %12.2e %10d' % (sum(r[0] for r in rows),
+                                                 sum(r[1] for r in rows),
+                                                 sum(r[2] for r in rows),
+                                                 sum(r[3] for r in rows),
+                                                 max(r[4] for r in rows),
+                                                 sum(r[5] for r in rows)))
+
+
+def main(target_cpp_files):
+    if not (prob_phys_units.is_cppcheck_available() and is_dai_available()):
+        prob_phys_units.eprint('the benchmark needs cppcheck and the libDAI python bindings')
+        return 1
+    PGMPlayer._run_inference = run_both_engines
+
+    my_type_miner = TypeMiner(prob_phys_units.training_filepath, prob_phys_units.types_filepath,
+                              prob_phys_units.suffix_filepath)
+    my_type_miner.train(True)
+
+    for target_cpp_file in target_cpp_files:
+        if not os.path.exists(target_cpp_file):
+            prob_phys_units.eprint('file does not exist: %s' % target_cpp_file)
+            continue
+        dump_file = prob_phys_units.prepare_dump_file(target_cpp_file)
+        if not dump_file:
+            continue
+        del benchmark_rows[:]
+        prob_phys_units.analyze_file(target_cpp_file, dump_file, my_type_miner, False, False, True,
+                                     con.ConstraintStore())
+        print_benchmark(target_cpp_file, benchmark_rows)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv[1:] or DEFAULT_BENCHMARK_FILES))
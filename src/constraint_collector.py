@@ -2,7 +2,8 @@
 #All rights reserved.
 
 
-import cppcheckdata                 # http://cppcheck.sourceforge.net/
+import dump_image
+from token_table import get_token_table
 from tree_walker import TreeWalker
 import cps_constraints as con
 import networkx as nx
@@ -12,8 +13,9 @@ from collections import OrderedDict
 
 class ConstraintCollector:
 
-    def __init__(self, my_type_miner):
+    def __init__(self, my_type_miner, constraint_store=None):
         self.SHOULD_PRINT_CONSTRAINTS = False
+        self.con = constraint_store if constraint_store is not None else con.ConstraintStore()
         self.type_miner = my_type_miner
         self.current_file_under_analysis = ''
         self.source_file = ''
@@ -33,6 +35,9 @@ class ConstraintCollector:
             each scope gets an empty list to hold variable unit assignments in that scope
             '''
         c = cppcheck_configuration
+        # TOKENS ARE RESET EAGERLY.  GENERATION-STAMPED SIDE TABLES MAKE THE RESET O(1) BUT ROUTE EVERY
+        # FIELD ACCESS THROUGH A DESCRIPTOR:  ON A 200K-TOKEN DUMP ONE EAGER RESET TAKES 0.40 s, WHILE
+        # 10 READ PASSES OVER ALL TOKENS GO FROM 0.19 s TO 1.2-1.4 s, AND A ROUND READS EACH TOKEN MANY TIMES
         for t in c.tokenlist:
             t.units = []
             t.isKnown = False
@@ -70,6 +75,7 @@ class ConstraintCollector:
             returns: dict containing function start and end tokens
         '''
         function_dicts = {}
+        token_table = get_token_table(a_cppcheck_configuration)
 
         # FIND FUNCTIONS IN 'SCOPES' REGION OF DUMP FILE, START AND END TOKENs
         for s in a_cppcheck_configuration.scopes:
@@ -82,54 +88,41 @@ class ConstraintCollector:
                                         'scopeObject':s,
                                         'symbol_table':{},
                                         'function_graph_edges':[],
-                                        'function':s.function}
+                                        'function':s.function, 
+                                        'token_table':token_table}
                 # CONSTRUCT LIST OF ROOT TOKENS
-                function_dicts[s.Id]['root_tokens'] = self.find_root_tokens(s.classStart, s.classEnd)
+                function_dicts[s.Id]['root_tokens'] = self.find_root_tokens(s.classStart, s.classEnd, token_table)
                     
         #print "Found %d functions..." % len(function_dicts)
         
         return function_dicts
 
 
-    def find_root_tokens(self, tokenStart, tokenEnd):
+    def find_root_tokens(self, tokenStart, tokenEnd, token_table):
         ''' FOR A FUNCTION DEFIND AS ALL TOKENS FROM tokenStart TO tokenEnd, FIND THE ROOTS
             input: tokenStart  a CPPCheckData Token, first token in a function
             input: tokenEnd    a CPPCheckData Token, last token in a function
+            input: token_table  TokenTable of the configuration, the walk up the AST runs over its arrays
             output: a list of root_tokens, in flow order
             '''
-        root_tokens_set = set()
-        current_token = tokenStart
-        while(current_token != tokenEnd):  #todo: reverse token set exploration to top-down instead of bottom-up
-            # HAS A PARENT
-            if current_token.astParent: 
-                a_parent = current_token.astParent
-                has_parent = True
-                while has_parent:
-                    # HAS NO PARENT, THEREFORE IS ROOT
-                    if not a_parent.astParent:     
-                        root_tokens_set.add(a_parent)
-                        a_parent.isRoot = True  # THIS PROPERTY IS A CUSTOM NEW PROPERTY
-                        has_parent = False
-                    else:
-                        a_parent = a_parent.astParent 
-            current_token = current_token.next
-
-        
-        root_tokens = list(root_tokens_set)
-        # SORT NUMERICALLY BY LINE NUMBER
-        root_tokens = sorted(root_tokens, key=lambda x : int(x.linenr))
+        root_indices = token_table.find_roots(token_table.index_of(tokenStart), 
+                                              token_table.index_of(tokenEnd))
+        root_tokens = []
+        for i in root_indices:
+            a_root = token_table.tokens[i]
+            a_root.isRoot = True  # THIS PROPERTY IS A CUSTOM NEW PROPERTY
+            root_tokens.append(a_root)
         return root_tokens
 
 
     def collect_constraints(self, function_dict):
-        tw = TreeWalker(self.type_miner, self.vnh)  
+        tw = TreeWalker(self.type_miner, self.vnh, self.con)  
+        tw.token_table = function_dict.get('token_table')
         tw.current_file = self.current_file_under_analysis
         tw.source_file_lines = self.source_file_lines
         tw.source_file = self.source_file
 
         # ASSUME THE TOKENS COME BACK AS A SORTED LIST
-        break_point = 1000
-        i=0
         found_units = False
 
         for root_token in function_dict['root_tokens']:
@@ -168,34 +161,7 @@ class ConstraintCollector:
 
             
             # CONTINUE TO ATTEMPT CHANGES UNTIL CHANGES CEASE
-            while tw.was_some_unit_changed:  
-                if i>break_point:
-                    s = "BREAKING WHILE LOOP AT %d" % break_point
-                    raise ValueError(s)
-                    return
-                i+=1
-                tw.was_some_unit_changed = False
-                # LOOK FOR EARLY ABANDONMENT OF THIS AST
-                if not tw.found_units_in_this_tree and self.should_abandon_early:
-                    break
-                ### PROPAGATE UNITS
-                tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_across_dot_connectors)
-                tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_across_double_colon)               
-                tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_across_square_brackets)
-                tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_across_assignment)
-                tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_math_abs_fabs_floor_ceil)
-                tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_math_min_max)
-                tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_math_fmod_fmodf_fmodl)
-                tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_sqrt)
-                # tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_getXYZ)
-                tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_ternary)
-                tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_pow)
-                tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_inverse_trig)
-                tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_across_operators)
-                tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_across_return)
-                tw.generic_recurse_and_apply_function(root_token, tw.collect_function_param_units_and_decorate_function)
-                tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_across_parenthesis)
-            # END -- WHILE LOOP
+            self.propagate_units_until_stable(tw, root_token)
 
             #RETURN STATEMENT WITH UNITS - STORE UNITS
             if root_token.str == 'return' and root_token.units:
@@ -229,12 +195,32 @@ class ConstraintCollector:
             function_dict['scopeObject'].function.maybe_generic_function = True
 
 
+    def propagate_units_until_stable(self, tw, root_token, break_point=1000):
+        ''' APPLY THE PROPAGATION RULES TO AN AST UNTIL NO UNIT CHANGES.  break_point BOUNDS THE ROUNDS OF 
+            THIS AST ALONE (IT USED TO BOUND THE ROUNDS OF ALL ASTS OF A FUNCTION, WHICH LONG FUNCTIONS EXCEEDED)
+            input: tw  TreeWalker, was_some_unit_changed set by the passes that applied the initial units
+            returns: number of rounds
+            '''
+        i = 0
+        while tw.was_some_unit_changed:  
+            if i>break_point:
+                s = "BREAKING WHILE LOOP AT %d" % break_point
+                raise ValueError(s)
+            i+=1
+            tw.was_some_unit_changed = False
+            # LOOK FOR EARLY ABANDONMENT OF THIS AST
+            if not tw.found_units_in_this_tree and self.should_abandon_early:
+                break
+            ### PROPAGATE UNITS
+            tw.propagate_units_one_round(root_token)
+        return i
+
+
     def repeat_collect_constraints(self, function_dict):
-        tw = TreeWalker(self.type_miner)  
+        tw = TreeWalker(self.type_miner, None, self.con)  
+        tw.token_table = function_dict.get('token_table')
 
         # ASSUME THE TOKENS COME BACK AS A SORTED LIST
-        break_point = 1000
-        i=0
 
         for root_token in function_dict['root_tokens']:
             #print root_token.str, root_token.linenr
@@ -272,34 +258,7 @@ class ConstraintCollector:
 
 
             # CONTINUE TO ATTEMPT CHANGES UNTIL CHANGES CEASE
-            while tw.was_some_unit_changed:  
-                if i>break_point:
-                    s = "BREAKING WHILE LOOP AT %d" % break_point
-                    raise ValueError(s)
-                    return
-                i+=1
-                tw.was_some_unit_changed = False
-                # LOOK FOR EARLY ABANDONMENT OF THIS AST
-                if not tw.found_units_in_this_tree and self.should_abandon_early:
-                    break
-                ### PROPAGATE UNITS
-                tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_across_dot_connectors)
-                tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_across_double_colon)                
-                tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_across_square_brackets)
-                tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_across_assignment)
-                tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_math_abs_fabs_floor_ceil)
-                tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_math_min_max)
-                tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_math_fmod_fmodf_fmodl)
-                tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_sqrt)
-                # tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_getXYZ)
-                tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_ternary)
-                tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_pow)
-                tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_inverse_trig)
-                tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_across_operators)
-                tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_across_return)
-                tw.generic_recurse_and_apply_function(root_token, tw.collect_function_param_units_and_decorate_function)
-                tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_across_parenthesis)
-            # END -- WHILE LOOP
+            self.propagate_units_until_stable(tw, root_token)
 
             #RETURN STATEMENT WITH UNITS - STORE UNITS
             if root_token.str == 'return' and root_token.units:
@@ -321,30 +280,30 @@ class ConstraintCollector:
 
 
     def print_all_naming_constraints(self):
-        for var, nm_con in con.naming_constraints.items():
+        for var, nm_con in self.con.naming_constraints.items():
             (lt, lname, units) = nm_con
             print "nm_constraint: %s %s" % (lname, units[:3])
 
     def print_all_computed_unit_constraints(self):
-        for var, cu_con in con.computed_unit_constraints.items():
+        for var, cu_con in self.con.computed_unit_constraints.items():
             units = []
             for (lt, lname, un, isKnown) in cu_con:
                 units.append(un)
             print "cu_constraint: %s %s" % (lname, units)
 
-        for (lt, lname, units, isKnown) in con.derived_cu_constraints:
+        for (lt, lname, units, isKnown) in self.con.derived_cu_constraints:
             print "cu_constraint: %s %s" % (lname, units)
 
     def print_all_df_constraints(self):
-        for (lt, lname, rt, rname, df_type) in con.df_constraints:
+        for (lt, lname, rt, rname, df_type) in self.con.df_constraints:
             print "df_constraint: %s %s, %s %s" % (lname, lt.units, rname, rt.units)
 
     def print_all_conversion_factor_constraints(self):
-        for (t, name, units, cf_type) in con.conversion_factor_constraints:
+        for (t, name, units, cf_type) in self.con.conversion_factor_constraints:
             print "cf_constraint: %s %s %s" % (name, units, cf_type)
 
     def print_all_known_symbol_constraints(self):
-        for var, ks_con in con.known_symbol_constraints.items():
+        for var, ks_con in self.con.known_symbol_constraints.items():
             (t, name, units) = ks_con[0]
             print "ks_constraint: %s %s" % (name, units)
 
@@ -356,8 +315,9 @@ class ConstraintCollector:
         '''
         self.source_file = source_file
         self.current_file_under_analysis = dump_file
-        # PARSE INPUT
-        data = cppcheckdata.parsedump(dump_file)
+        # PARSE INPUT  (ONLY THE FIRST CONFIGURATION IS ANALYZED, DO NOT LOAD THE OTHERS)
+        # FROM THE BINARY IMAGE OF THE DUMP WHEN ONE IS UP TO DATE
+        data = dump_image.load_first_configuration(dump_file)
         analysis_unit_dict = {}
 
         # GIVE TREE WALKER ACCESS TO SOURCE FILE FOR DEBUG PRINT
@@ -401,8 +361,8 @@ class ConstraintCollector:
 
     def repeat_run_collect(self, i):
         if (i > 2):
-            con.is_repeat_round = True
-        con.reset_constraints()
+            self.con.is_repeat_round = True
+        self.con.reset_constraints()
 
         # ASSUME ONLY ONE CONFIGURATION
         self.init_cppcheck_config_data_structures(self.configurations[0])
@@ -422,11 +382,10 @@ class ConstraintCollector:
 
 
     def propagate_units(self, function_dict):
-        tw = TreeWalker(self.type_miner)  
+        tw = TreeWalker(self.type_miner, None, self.con)  
+        tw.token_table = function_dict.get('token_table')
 
         # ASSUME THE TOKENS COME BACK AS A SORTED LIST
-        break_point = 1000
-        i=0
 
         for root_token in function_dict['root_tokens']:
             #print root_token.str, root_token.linenr
@@ -463,34 +422,7 @@ class ConstraintCollector:
 
             
             # CONTINUE TO ATTEMPT CHANGES UNTIL CHANGES CEASE
-            while tw.was_some_unit_changed:  
-                if i>break_point:
-                    s = "BREAKING WHILE LOOP AT %d" % break_point
-                    raise ValueError(s)
-                    return
-                i+=1
-                tw.was_some_unit_changed = False
-                # LOOK FOR EARLY ABANDONMENT OF THIS AST
-                if not tw.found_units_in_this_tree and self.should_abandon_early:
-                    break
-                ### PROPAGATE UNITS
-                tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_across_dot_connectors)
-                tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_across_double_colon)                
-                tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_across_square_brackets)
-                tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_across_assignment)
-                tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_math_abs_fabs_floor_ceil)
-                tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_math_min_max)
-                tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_math_fmod_fmodf_fmodl)
-                tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_sqrt)
-                # tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_getXYZ)
-                tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_ternary)
-                tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_pow)
-                tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_inverse_trig)
-                tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_across_operators)
-                tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_across_return)
-                tw.generic_recurse_and_apply_function(root_token, tw.collect_function_param_units_and_decorate_function)
-                tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_across_parenthesis)
-            # END -- WHILE LOOP
+            self.propagate_units_until_stable(tw, root_token)
 
             #RETURN STATEMENT WITH UNITS - STORE UNITS
             if root_token.str == 'return' and root_token.units:
@@ -506,8 +438,8 @@ class ConstraintCollector:
 
 
     def repeat_run_propagate(self, thresh):
-        con.unit_prob_threshold = thresh
-        con.reset_constraints()
+        self.con.unit_prob_threshold = thresh
+        self.con.reset_constraints()
 
         # ASSUME ONLY ONE CONFIGURATION
         self.init_cppcheck_config_data_structures(self.configurations[0])
@@ -17,8 +17,8 @@ class ConstraintScope:
 
 class ConstraintScoper:
 
-    def __init__(self):
-
+    def __init__(self, constraint_store=None):
+        self.con = constraint_store if constraint_store is not None else con.ConstraintStore()
         self.scope_dir = {}
         self.scope_pairs = []
         self.scoped_var_tokens = []
@@ -28,11 +28,11 @@ class ConstraintScoper:
 
 
     def scan_cu_constraints(self):
-        for var, cu_con in con.computed_unit_constraints.items():
+        for var, cu_con in self.con.computed_unit_constraints.items():
             if len(cu_con) < 2:
                 continue
             (lt, lname, units, isKnown) = cu_con[0]
-            if (not con.is_only_known_unit_variable(lt.variable, lname)):
+            if (not self.con.is_only_known_unit_variable(lt.variable, lname)):
                 continue
             #units = map(lambda (t,n,u,k): u, cu_con)
             #units_set = []
@@ -6,6 +6,10 @@
 #
 
 import xml.etree.ElementTree as ET
+try:
+    import xml.etree.cElementTree as cET
+except ImportError:
+    cET = ET
 import argparse
 
 # Directive class. Contains information about each preprocessor directive
@@ -442,8 +446,8 @@ class Configuration:
     # List of ValueFlow values
     valueflow = []
 
-    def __init__(self, confignode):
-        self.name = confignode.get('cfg')
+    def __init__(self, confignode=None):
+        self.name = ''
         self.directives = []
         self.tokenlist = []
         self.scopes = []
@@ -451,6 +455,11 @@ class Configuration:
         self.variables = []
         self.valueflow = []
 
+        # an empty Configuration is filled in by parsedump_streaming
+        if confignode is None:
+            return
+
+        self.name = confignode.get('cfg')
         for element in confignode:
             if element.tag == 'directivelist':
                 for directive in element:
@@ -459,14 +468,6 @@ class Configuration:
             if element.tag == 'tokenlist':
                 for token in element:
                     self.tokenlist.append(Token(token))
-
-                # set next/previous..
-                prev = None
-                for token in self.tokenlist:
-                    token.previous = prev
-                    if prev:
-                        prev.next = token
-                    prev = token
             if element.tag == 'scopes':
                 for scope in element:
                     self.scopes.append(Scope(scope))
@@ -481,6 +482,17 @@ class Configuration:
                 for values in element:
                     self.valueflow.append(ValueFlow(values))
 
+        self.setIdMap()
+
+    # set next/previous and resolve the ids of every item
+    def setIdMap(self):
+        prev = None
+        for token in self.tokenlist:
+            token.previous = prev
+            if prev:
+                prev.next = token
+            prev = token
+
         IdMap = {}
         IdMap[None] = None
         IdMap['0'] = None
@@ -541,13 +553,19 @@ class CppcheckData:
     # List of Configurations
     configurations = []
 
-    def __init__(self, filename):
+    def __init__(self, filename=None):
         self.configurations = []
 
+        # an empty CppcheckData is filled in by parsedump_streaming
+        if filename is None:
+            return
+
         data = ET.parse(filename)
         # root is 'dumps' node, each config has its own 'dump' subnode.
+        # other subnodes (eg: rawtokens) are not configurations.
         for cfgnode in data.getroot():
-            self.configurations.append(Configuration(cfgnode))
+            if cfgnode.tag == 'dump':
+                self.configurations.append(Configuration(cfgnode))
 
 # parse a cppcheck dump file
 
@@ -555,6 +573,117 @@ class CppcheckData:
 def parsedump(filename):
     return CppcheckData(filename)
 
+
+# Compact Token for parsedump_streaming: same fields and methods as Token,
+# but stored in __slots__, including the fields the phys analysis adds
+# (see ConstraintCollector.init_cppcheck_config_data_structures).
+# ValueFlow is not loaded, so values is always None.
+
+SLOT_TOKEN_FIELDS = ('Id', 'str', 'next', 'previous', 'linkId', 'link', 'scopeId', 'scope',
+                     'isName', 'isNumber', 'isInt', 'isFloat', 'isString', 'strlen', 'isChar',
+                     'isOp', 'isArithmeticalOp', 'isAssignmentOp', 'isComparisonOp', 'isLogicalOp',
+                     'unitType', 'varId', 'variableId', 'variable', 'functionId', 'function',
+                     'valuesId', 'values', 'typeScopeId', 'typeScope', 'astParentId', 'astParent',
+                     'astOperand1Id', 'astOperand1', 'astOperand2Id', 'astOperand2', 'file', 'linenr')
+
+ANALYSIS_TOKEN_FIELDS = ('units', 'isKnown', 'is_unit_propagation_based_on_constants',
+                         'is_unit_propagation_based_on_unknown_variable',
+                         'is_unit_propagation_based_on_weak_inference',
+                         'isRoot', 'hasVarOperand', 'isDimensionless')
+
+# results of SymbolHelper lookups that only depend on the AST, memoized on the
+# token (see symbol_helper.cached_on_token)
+CACHE_TOKEN_FIELDS = ('compound_names',)
+
+# token strings, file names and line numbers repeat a lot, keep one copy of each
+shared_strings = {}
+
+
+class SlotToken(object):
+    __slots__ = SLOT_TOKEN_FIELDS + ANALYSIS_TOKEN_FIELDS + CACHE_TOKEN_FIELDS
+
+    def __init__(self, element):
+        for name in SLOT_TOKEN_FIELDS:
+            if name != 'unitType':
+                setattr(self, name, getattr(Token, name, None))
+        Token.__dict__['__init__'](self, element)
+        self.valuesId = None
+        self.str = shared_strings.setdefault(self.str, self.str)
+        self.file = shared_strings.setdefault(self.file, self.file)
+        self.linenr = shared_strings.setdefault(self.linenr, self.linenr)
+
+    setId = Token.__dict__['setId']
+    getValue = Token.__dict__['getValue']
+
+
+# sections of a configuration that parsedump_streaming never loads
+SKIPPED_DUMP_SECTIONS = ('directivelist', 'valueflow')
+
+
+# parse only one configuration of a cppcheck dump file, without building the
+# whole XML tree: elements are dropped as soon as they are converted, the
+# directive list and the ValueFlow are skipped, tokens are SlotToken, and the
+# file is not read past the requested configuration.  Elements next to the
+# dump nodes (eg: rawtokens) are dropped as they are read.
+# Returns a CppcheckData holding that configuration only (or none if the dump
+# has fewer configurations).
+
+
+def parsedump_streaming(filename, configuration_index=0):
+    data = CppcheckData()
+    nr_configurations = 0
+    cfg = None
+    depth = 0
+    top_node = None
+    dump_node = None
+    section = None
+    with open(filename, 'rb') as f:
+        for (event, element) in cET.iterparse(f, events=('start', 'end')):
+            if event == 'start':
+                depth += 1
+                if depth == 1:
+                    root = element
+                elif depth == 2:
+                    top_node = element
+                    if element.tag == 'dump':
+                        dump_node = element
+                        if nr_configurations == configuration_index:
+                            cfg = Configuration()
+                            cfg.name = element.get('cfg')
+                elif depth == 3:
+                    section = element
+                continue
+
+            depth -= 1
+            if depth == 3:
+                # one item of a section, with all its children
+                if cfg is not None and section.tag not in SKIPPED_DUMP_SECTIONS:
+                    if section.tag == 'tokenlist' and element.tag == 'token':
+                        cfg.tokenlist.append(SlotToken(element))
+                    elif section.tag == 'scopes' and element.tag == 'scope':
+                        cfg.scopes.append(Scope(element))
+                        for functionList in element:
+                            if functionList.tag == 'functionList':
+                                for function in functionList:
+                                    cfg.functions.append(Function(function))
+                    elif section.tag == 'variables' and element.tag == 'var':
+                        cfg.variables.append(Variable(element))
+                section.clear()
+            elif depth == 2:
+                # a section of a dump node, or an item next to the dump nodes
+                top_node.clear()
+            elif depth == 1:
+                root.clear()
+                if element is not dump_node:
+                    continue
+                nr_configurations += 1
+                dump_node = None
+                if cfg is not None:
+                    cfg.setIdMap()
+                    data.configurations.append(cfg)
+                    break
+    return data
+
 # Check if type of ast node is float/double
 
 
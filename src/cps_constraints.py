@@ -1,252 +1,346 @@
-import sys
-
-this = sys.modules[__name__]
-
-this.var_count = 0
-this.variables = {}
-this.non_unit_variables = []
-this.int_unit_variables = []
-this.multi_unit_variables = []
-this.dimensionless_variables = []
-this.known_unit_variables = {}
-
-this.naming_constraints = {}
-this.df_constraints = []
-this.unique_df_constraints = []
-this.computed_unit_constraints = {}
-this.conversion_factor_constraints = []
-this.unique_cf_constraints = []
-this.known_symbol_constraints = {}
-
-this.excluded_cu_constraints = []
-this.derived_cu_constraints = []
-
-this.units = []
-
-this.variable2unitproba = {}
-this.phys_corrections = {}
-
-this.unit_prob_threshold = 0.5
-this.found_ros_units = False
-this.is_repeat_round = False
-this.ENABLE_UNIT_LIST_FLATTENING = False
-this.FOUND_DERIVED_CU_VARIABLE = False
-
-this.DF_1 = 1
-this.DF_2 = 2
-this.CF_1 = 1
-this.CF_2 = 2
-this.CF_3 = 3
-
-
-def reset_constraints():
-    #this.naming_constraints = {}
-    #this.df_constraints = []
-    this.computed_unit_constraints = {}
-    this.multi_unit_variables = []
-    this.known_unit_variables = {}
-    #this.conversion_factor_constraints = []
-    #this.known_symbol_constraints = {}
-    #this.units = []
-
-
-def add_non_unit_variable(token, name):
-    if (token.variable, name) not in this.non_unit_variables:
-        this.non_unit_variables.append((token.variable, name))
-
-
-def is_non_unit_variable(token, name):
-    return ((token.variable, name) in this.non_unit_variables)
+import phys_unit
+
+
+# CONSTRAINT TYPES
+DF_1 = 1
+DF_2 = 2
+CF_1 = 1
+CF_2 = 2
+CF_3 = 3
+
+
+def get_units_key(units):
+    ''' HASHABLE SNAPSHOT OF A UNIT OR OF A (NESTED) LIST OF UNITS, EQUAL WHEN THE UNITS ARE EQUAL.
+        A UNIT IS ITS INTERNED PhysUnit, WHICH ALSO COVERS THE {attribute: unit} OF A NESTED ROS MESSAGE
+        '''
+    if isinstance(units, (list, tuple)):
+        return tuple(get_units_key(u) for u in units)
+    if isinstance(units, dict):
+        return phys_unit.make_unit(units)
+    return units
+
+
+class ConstraintStore(object):
+    ''' EVERY CONSTRAINT TABLE OF ONE ANALYSIS.  ONE STORE IS CREATED PER ANALYZED FILE AND HANDED TO ITS
+        ConstraintCollector, TreeWalkers, SymbolHelpers, ConstraintSolver, ConstraintScoper AND ErrorChecker
+        (AS self.con), SO SEVERAL FILES CAN BE ANALYZED IN ONE PROCESS AT THE SAME TIME
+        '''
+
+    def __init__(self):
+        self.var_count = 0
+        self.variables = {}
+        self.non_unit_variables = set()
+        self.int_unit_variables = set()
+        self.multi_unit_variables = []
+        self.dimensionless_variables = set()
+        self.known_unit_variables = {}
+
+        self.naming_constraints = {}
+        self.df_constraints = []
+        # DF_2 CONSTRAINTS ALREADY ADDED, BOTH ORIENTATIONS:  (lvariable, lname, rvariable, rname)
+        self.unique_df_constraints = set()
+        # (lt.Id, lname) -> [(rt, rname)] OF EVERY df CONSTRAINT
+        self.df_constraints_by_token = {}
+        self.computed_unit_constraints = {}
+        self.conversion_factor_constraints = []
+        # (variable, name, units key, cf_type)
+        self.unique_cf_constraints = set()
+        self.known_symbol_constraints = {}
+        # (token.Id, name, units key) OF EVERY ks CONSTRAINT, REPEATS INCLUDED IN known_symbol_constraints
+        self.unique_ks_constraints = set()
+
+        # (token, name, units key, isKnown)
+        self.excluded_cu_constraints = set()
+        self.derived_cu_constraints = []
+        self.derived_cu_constraint_keys = set()
+
+        # BITS OF THE UNIT LISTS MERGED BY THE TREE WALKERS AND SymbolHelpers OF THIS ANALYSIS
+        self.unit_vocabulary = phys_unit.UnitVocabulary()
+
+        # IN ORDER OF FIRST USE, units_keys HOLDS THE SAME UNITS FOR MEMBERSHIP
+        self.units = []
+        self.units_keys = set()
+
+        self.variable2unitproba = {}
+        self.variable_id2unitproba_key = {}
+        self.top_units_cache = {}
+        self.phys_corrections = {}
+
+        self.unit_prob_threshold = 0.5
+        self.found_ros_units = False
+        self.is_repeat_round = False
+        self.ENABLE_UNIT_LIST_FLATTENING = False
+        self.FOUND_DERIVED_CU_VARIABLE = False
+
+
+    def reset_constraints(self):
+        #self.naming_constraints = {}
+        #self.df_constraints = []
+        self.computed_unit_constraints = {}
+        self.multi_unit_variables = []
+        self.known_unit_variables = {}
+        #self.conversion_factor_constraints = []
+        #self.known_symbol_constraints = {}
+        #self.units = []
+
+
+    def get_distinct_constraint_counts(self):
+        ''' THE TABLES reset_constraints KEEPS FROM ONE ROUND TO THE NEXT ONLY GROW.  known_symbol_constraints 
+            GETS EVERY ks CONSTRAINT AGAIN IN EACH ROUND AND conversion_factor_constraints GETS EVERY cf 
+            CONSTRAINT AGAIN IN ROUND 2;  THOSE REPEATS ARE NOT COUNTED, ONLY DISTINCT CONSTRAINTS ARE.
+            EQUAL COUNTS AFTER TWO ROUNDS MEAN THE LATER ROUND ADDED NO NEW CONSTRAINT
+            returns: tuple of table sizes
+            '''
+        return (len(self.variables), 
+                len(self.naming_constraints), 
+                len(self.df_constraints), 
+                len(self.unique_cf_constraints), 
+                len(self.unique_ks_constraints), 
+                len(self.derived_cu_constraints), 
+                len(self.excluded_cu_constraints), 
+                len(self.non_unit_variables), 
+                len(self.int_unit_variables), 
+                len(self.dimensionless_variables), 
+                len(self.units))
+
+
+    def set_variable2unitproba(self, var2unitproba):
+        ''' STORE THE RESULT OF A SOLVE, WITH AN INDEX BY (variable.Id, name) SO A TOKEN OF ANOTHER PARSE
+            OF THE SAME DUMP FINDS ITS ENTRY IN O(1)
+            input: {(variable, name): [(unit, proba)], best first}
+            '''
+        self.variable2unitproba = var2unitproba
+        self.variable_id2unitproba_key = {}
+        for (variable, name) in var2unitproba:
+            self.variable_id2unitproba_key.setdefault((variable.Id, name), (variable, name))
+        self.top_units_cache = {}
+
+
+    def find_unitproba_key(self, variable, name):
+        ''' returns: the (variable, name) key of variable2unitproba for a variable with the same Id, or None
+            '''
+        return self.variable_id2unitproba_key.get((variable.Id, name))
+
+
+    def get_top_units(self, unitproba_key, n):
+        ''' UNITS OF A variable2unitproba ENTRY ABOVE unit_prob_threshold WHOSE PROBABILITY IS ONE OF THE n BEST
+            (DISTINCT) PROBABILITIES, IN THE ORDER OF THE ENTRY.  COMPUTED ONCE PER ENTRY, n, THRESHOLD AND 
+            FLATTENING MODE (add_cu_constraint CAN TURN FLATTENING ON BETWEEN TWO CALLS)
+            returns: list of units, flattened if ENABLE_UNIT_LIST_FLATTENING
+            '''
+        cache_key = (unitproba_key, n, self.unit_prob_threshold, self.ENABLE_UNIT_LIST_FLATTENING)
+        if cache_key not in self.top_units_cache:
+            units = [(u, p) for (u, p) in self.variable2unitproba[unitproba_key] if p > self.unit_prob_threshold]
+            probas = sorted(set(p for (u, p) in units), reverse=True)[:n]
+            units = [u for (u, p) in units if p in probas]
+            if self.ENABLE_UNIT_LIST_FLATTENING:
+                units = self.flatten_unit_list(units)
+            self.top_units_cache[cache_key] = units
+        return list(self.top_units_cache[cache_key])
+
+
+    def add_non_unit_variable(self, token, name):
+        self.non_unit_variables.add((token.variable, name))
+
+
+    def is_non_unit_variable(self, token, name):
+        return ((token.variable, name) in self.non_unit_variables)
+
+
+    def add_int_unit_variable(self, token, name):
+        self.int_unit_variables.add((token.variable, name))
+
+
+    def is_int_unit_variable(self, token, name):
+        return ((token.variable, name) in self.int_unit_variables)
 
 
-def add_int_unit_variable(token, name):
-    if (token.variable, name) not in this.int_unit_variables:
-        this.int_unit_variables.append((token.variable, name))
+    def add_multi_unit_variable(self, root_token, token, name, units, isKnownRhs=False):
+        if (root_token, token, name, units, isKnownRhs) not in self.multi_unit_variables:
+            self.multi_unit_variables.append((root_token, token, name, units, isKnownRhs))
+
+
+    def add_dimensionless_variable(self, token, name):
+        self.dimensionless_variables.add((token.variable, name))
+
+
+    def add_known_unit_variable(self, token, name, isKnown, isUnknown):
+        knownStatus = self.known_unit_variables.get((token.variable, name))
+        if not knownStatus:
+            self.known_unit_variables[(token.variable, name)] = (isKnown, isUnknown)
+        else:
+            (k, uk) = knownStatus
+            k = k or isKnown
+            uk = uk or isUnknown
+            self.known_unit_variables[(token.variable, name)] = (k, uk)    
+
 
+    def is_only_known_unit_variable(self, tokenvar, name):
+        knownStatus = self.known_unit_variables.get((tokenvar, name))
+        if knownStatus:
+            (k, uk) = knownStatus
+            if (k) and (not uk):
+                return True
+        return False
 
-def is_int_unit_variable(token, name):
-    return ((token.variable, name) in this.int_unit_variables)
 
+    def print_known_unit_variables(self):
+        print "Known Unit Variables:"
+        for var, knownStatus in self.known_unit_variables.items():
+            (k, uk) = knownStatus
+            if (k) and (not uk):
+                print var
 
-def add_multi_unit_variable(root_token, token, name, units, isKnownRhs=False):
-    if (root_token, token, name, units, isKnownRhs) not in this.multi_unit_variables:
-        this.multi_unit_variables.append((root_token, token, name, units, isKnownRhs))
 
+    def add_variable(self, token, name):
+        self.var_count += 1
+        self.variables[(token.variable, name)] = self.var_count
+        return self.var_count 
 
-def add_dimensionless_variable(token, name):
-    if (token.variable, name) not in this.dimensionless_variables:
-        this.dimensionless_variables.append((token.variable, name))
 
+    def get_variable_id(self, token, name):
+        return self.variables.get((token.variable, name))
 
-def add_known_unit_variable(token, name, isKnown, isUnknown):
-    knownStatus = this.known_unit_variables.get((token.variable, name))
-    if not knownStatus:
-        this.known_unit_variables[(token.variable, name)] = (isKnown, isUnknown)
-    else:
-        (k, uk) = knownStatus
-        k = k or isKnown
-        uk = uk or isUnknown
-        this.known_unit_variables[(token.variable, name)] = (k, uk)    
 
-
-def is_only_known_unit_variable(tokenvar, name):
-    knownStatus = this.known_unit_variables.get((tokenvar, name))
-    if knownStatus:
-        (k, uk) = knownStatus
-        if (k) and (not uk):
-            return True
-    return False
-
-
-def print_known_unit_variables():
-    print "Known Unit Variables:"
-    for var, knownStatus in this.known_unit_variables.items():
-        (k, uk) = knownStatus
-        if (k) and (not uk):
-            print var
-            
-
-def add_variable(token, name):
-    this.var_count += 1
-    this.variables[(token.variable, name)] = this.var_count
-    return this.var_count 
-
-
-def get_variable_id(token, name):
-    return this.variables.get((token.variable, name))
-
-
-def track_unit(unit):
-    if unit and unit not in this.units:
-        this.units.append(unit)
+    def track_unit(self, unit):
+        if not unit:
+            return
+        unit_key = get_units_key(unit)
+        if unit_key not in self.units_keys:
+            self.units_keys.add(unit_key)
+            self.units.append(unit)
 
 
-def add_nm_constraint(token, name, unitprobalist):
-    var = this.variables.get((token.variable, name))
-    if not var:    
-        var = this.add_variable(token, name)
-    for unitproba in unitprobalist[:3]:
-        this.track_unit(unitproba[0])
-    this.naming_constraints[var] = (token, name, unitprobalist)
-
-
-def is_nm_constraint_present(var):
-    return (var in this.naming_constraints)
- 
-
-def add_cu_constraint(ltoken, lname, units, isKnown):
-    var = this.variables.get((ltoken.variable, lname))
-    if not var:    
-        var = this.add_variable(ltoken, lname)
-    this.track_unit(units[0])
-    cu_con = this.computed_unit_constraints.get(var)
-    if not cu_con:
-        this.computed_unit_constraints[var] = [(ltoken, lname, units, isKnown)]
-    else:
-        cu_con.append((ltoken, lname, units, isKnown))
+    def add_nm_constraint(self, token, name, unitprobalist):
+        var = self.variables.get((token.variable, name))
+        if not var:    
+            var = self.add_variable(token, name)
+        for unitproba in unitprobalist[:3]:
+            self.track_unit(unitproba[0])
+        self.naming_constraints[var] = (token, name, unitprobalist)
 
 
-def scan_and_create_cu_constraints(ltoken, lname):
-    if (not this.is_only_known_unit_variable(ltoken.variable, lname)):
-        return
+    def is_nm_constraint_present(self, var):
+        return (var in self.naming_constraints)
 
-    var = this.variables.get((ltoken.variable, lname))
-    if not var:
-        return
 
-    cu_con = this.computed_unit_constraints.get(var)
-    if len(cu_con) < 2:
-        return
-                    
-    i = len(cu_con)-1
-    (t1, n1, u1, k1) = cu_con[i-1]
-    (t2, n2, u2, k2) = cu_con[i]
-    if (u1 != u2) and (t1.scopeId != t2.scopeId) and (t1.scope.type == 'If' and t2.scope.type == 'Try'):
-        u = []
-        u.extend(u1)
-        u.extend(u2)
-        #u = [tuple(u)]
-        new_con = (t2, n2, u, True)
-
-        if (t1, n1, u1, k1) not in this.excluded_cu_constraints:
-            this.excluded_cu_constraints.append((t1, n1, u1, k1))
-        if (t2, n2, u2, k2) not in this.excluded_cu_constraints:
-            this.excluded_cu_constraints.append((t2, n2, u2, k2))
-        if new_con not in this.derived_cu_constraints:
-            this.derived_cu_constraints.append(new_con)
-            this.track_unit(u)
-            this.ENABLE_UNIT_LIST_FLATTENING = True
-
-
-def should_exclude_constraint(cu):
-    return (cu in this.excluded_cu_constraints)
-
-
-def add_df_constraint(ltoken, lname, rtoken, rname, df_type):
-    lvar = this.variables.get((ltoken.variable, lname))
-    rvar = this.variables.get((rtoken.variable, rname))
-    if (not ltoken.units) and (not lvar):
-        lvar = this.add_variable(ltoken, lname)
-    if (not rtoken.units) and (not rvar):
-        rvar = this.add_variable(rtoken, rname)
-    if (ltoken.units):
-        this.track_unit(ltoken.units[0])
-    if (rtoken.units):
-        this.track_unit(rtoken.units[0])
-
-    if df_type == this.DF_2:
-        if ((ltoken.variable, lname, rtoken.variable, rname, df_type) not in this.unique_df_constraints) and \
-                ((rtoken.variable, rname, ltoken.variable, lname, df_type) not in this.unique_df_constraints):
-            this.unique_df_constraints.append((ltoken.variable, lname, rtoken.variable, rname, df_type))
-            this.df_constraints.append((ltoken, lname, rtoken, rname, df_type))
-    else:
-        this.df_constraints.append((ltoken, lname, rtoken, rname, df_type)) 
-
-
-def is_df_constraint_present(token, name):
-    for (lt, lname, rt, rname, df_type) in this.df_constraints:
-        if (lt.Id == token.Id) and (lname == name):
-            if not (rt.isKnown or this.is_only_known_unit_variable(rt.variable, rname)):
+    def add_cu_constraint(self, ltoken, lname, units, isKnown):
+        var = self.variables.get((ltoken.variable, lname))
+        if not var:    
+            var = self.add_variable(ltoken, lname)
+        self.track_unit(units[0])
+        cu_con = self.computed_unit_constraints.get(var)
+        if not cu_con:
+            self.computed_unit_constraints[var] = [(ltoken, lname, units, isKnown)]
+        else:
+            cu_con.append((ltoken, lname, units, isKnown))
+
+
+    def scan_and_create_cu_constraints(self, ltoken, lname):
+        if (not self.is_only_known_unit_variable(ltoken.variable, lname)):
+            return
+
+        var = self.variables.get((ltoken.variable, lname))
+        if not var:
+            return
+
+        cu_con = self.computed_unit_constraints.get(var)
+        if len(cu_con) < 2:
+            return
+
+        i = len(cu_con)-1
+        (t1, n1, u1, k1) = cu_con[i-1]
+        (t2, n2, u2, k2) = cu_con[i]
+        if (u1 != u2) and (t1.scopeId != t2.scopeId) and (t1.scope.type == 'If' and t2.scope.type == 'Try'):
+            u = []
+            u.extend(u1)
+            u.extend(u2)
+            #u = [tuple(u)]
+            new_con = (t2, n2, u, True)
+
+            self.excluded_cu_constraints.add(self.get_cu_constraint_key((t1, n1, u1, k1)))
+            self.excluded_cu_constraints.add(self.get_cu_constraint_key((t2, n2, u2, k2)))
+            new_con_key = self.get_cu_constraint_key(new_con)
+            if new_con_key not in self.derived_cu_constraint_keys:
+                self.derived_cu_constraint_keys.add(new_con_key)
+                self.derived_cu_constraints.append(new_con)
+                self.track_unit(u)
+                self.ENABLE_UNIT_LIST_FLATTENING = True
+
+
+    def get_cu_constraint_key(self, cu):
+        (token, name, units, isKnown) = cu
+        return (token, name, get_units_key(units), isKnown)
+
+
+    def should_exclude_constraint(self, cu):
+        return (self.get_cu_constraint_key(cu) in self.excluded_cu_constraints)
+
+
+    def add_df_constraint(self, ltoken, lname, rtoken, rname, df_type):
+        lvar = self.variables.get((ltoken.variable, lname))
+        rvar = self.variables.get((rtoken.variable, rname))
+        if (not ltoken.units) and (not lvar):
+            lvar = self.add_variable(ltoken, lname)
+        if (not rtoken.units) and (not rvar):
+            rvar = self.add_variable(rtoken, rname)
+        if (ltoken.units):
+            self.track_unit(ltoken.units[0])
+        if (rtoken.units):
+            self.track_unit(rtoken.units[0])
+
+        if df_type == DF_2:
+            if (ltoken.variable, lname, rtoken.variable, rname) in self.unique_df_constraints:
+                return
+            self.unique_df_constraints.add((ltoken.variable, lname, rtoken.variable, rname))
+            self.unique_df_constraints.add((rtoken.variable, rname, ltoken.variable, lname))
+        self.df_constraints.append((ltoken, lname, rtoken, rname, df_type))
+        self.df_constraints_by_token.setdefault((ltoken.Id, lname), []).append((rtoken, rname))
+
+
+    def is_df_constraint_present(self, token, name):
+        for (rt, rname) in self.df_constraints_by_token.get((token.Id, name), ()):
+            if not (rt.isKnown or self.is_only_known_unit_variable(rt.variable, rname)):
                 return True
-    return False
-
-
-def add_cf_constraint(token, name, units, cf_type):
-    var = this.variables.get((token.variable, name))
-    if not var:    
-        var = this.add_variable(token, name)
-    this.track_unit(units[0])
-    if (token.variable, name, units, cf_type) not in this.unique_cf_constraints:
-        this.unique_cf_constraints.append((token.variable, name, units, cf_type))
-        if this.is_repeat_round:
-            this.conversion_factor_constraints.append((token, name, units, cf_type))
-    if not this.is_repeat_round:
-        this.conversion_factor_constraints.append((token, name, units, cf_type)) 
-
-
-def add_ks_constraint(token, name, units):
-    var = this.variables.get((token.variable, name))
-    if not var:    
-        var = this.add_variable(token, name)
-    this.track_unit(units[0])
-    ks_con = this.known_symbol_constraints.get(var)
-    if not ks_con:
-        this.known_symbol_constraints[var] = [(token, name, units)]
-    else:
-        ks_con.append((token, name, units))
-
-
-def flatten_unit_list(units):
-    temp = []
-    for u in units:
-        if isinstance(u, list):
-            this.FOUND_DERIVED_CU_VARIABLE = True
-            for e in u:
-                if e not in temp:
-                    temp.append(e)                
+        return False
+
+
+    def add_cf_constraint(self, token, name, units, cf_type):
+        var = self.variables.get((token.variable, name))
+        if not var:    
+            var = self.add_variable(token, name)
+        self.track_unit(units[0])
+        cf_key = (token.variable, name, get_units_key(units), cf_type)
+        if cf_key not in self.unique_cf_constraints:
+            self.unique_cf_constraints.add(cf_key)
+            if self.is_repeat_round:
+                self.conversion_factor_constraints.append((token, name, units, cf_type))
+        if not self.is_repeat_round:
+            self.conversion_factor_constraints.append((token, name, units, cf_type)) 
+
+
+    def add_ks_constraint(self, token, name, units):
+        var = self.variables.get((token.variable, name))
+        if not var:    
+            var = self.add_variable(token, name)
+        self.track_unit(units[0])
+        self.unique_ks_constraints.add((token.Id, name, get_units_key(units)))
+        ks_con = self.known_symbol_constraints.get(var)
+        if not ks_con:
+            self.known_symbol_constraints[var] = [(token, name, units)]
         else:
-            if u not in temp:
-                temp.append(u)
-    return temp
-
-
+            ks_con.append((token, name, units))
+
+
+    def flatten_unit_list(self, units):
+        temp = []
+        for u in units:
+            if isinstance(u, list):
+                self.FOUND_DERIVED_CU_VARIABLE = True
+                for e in u:
+                    if e not in temp:
+                        temp.append(e)                
+            else:
+                if u not in temp:
+                    temp.append(u)
+        return temp
@@ -32,6 +32,9 @@ class TypeMiner(object):
 
         #acc, pose
 
+        # PREDICTIONS ARE PURE FUNCTIONS OF THE NAME, KEEP THEM ACROSS FILES (WORKSPACE MODE)
+        self.vname2proba = {}
+
 
     def train(self, should_reuse_training=False):
         _log("starting init suffix data... %s " % strftime("%Y-%m-%d %H:%M:%S", gmtime()))
@@ -49,6 +52,12 @@ class TypeMiner(object):
 
 
     def predict_proba(self, vname):
+        if vname not in self.vname2proba:
+            self.vname2proba[vname] = self._predict_proba(vname)
+        return self.vname2proba[vname]
+
+
+    def _predict_proba(self, vname):
         terms = self._get_meaningful_term(vname)
         #print terms
         if not terms:
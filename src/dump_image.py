@@ -0,0 +1,309 @@
+#!/usr/bin/env python
+
+from __future__ import print_function
+import cppcheckdata
+import gc
+import mmap
+import os
+import struct
+import sys
+import types
+from array import array
+from itertools import izip
+
+
+# BINARY IMAGE OF ONE PARSED cppcheck Configuration, WRITTEN NEXT TO THE DUMP (<dump>.img).
+# EVERYTHING IS A COLUMN OF int32:  STRINGS ARE INDICES INTO ONE STRING TABLE, LINKS BETWEEN TOKENS, SCOPES,
+# FUNCTIONS AND VARIABLES ARE INDICES INTO [tokens + scopes + functions + variables], -1 IS None.
+# THE IMAGE IS A FASTER SERIALIZATION THAN THE XML, NOT A SHARED MAPPING:  read_image STILL BUILDS EVERY
+# TOKEN, SCOPE, FUNCTION AND VARIABLE AS A PYTHON OBJECT OF ITS OWN PROCESS, SO A LOAD IS O(TOKENS)
+# (ABOUT HALF THE TIME OF parsedump_streaming).  IT PAYS OFF WHEN THE SAME DUMP IS LOADED AGAIN:
+# BY THE RECHECKER IN THE SAME RUN, OR ON A LATER RUN WHEN THE DUMP IS KEPT IN THE RESULT CACHE
+
+# BUMP WHEN THE LAYOUT CHANGES
+IMAGE_FORMAT_VERSION = 3
+IMAGE_MAGIC = 'PHYSIMG\0'
+IMAGE_SUFFIX = '.img'
+
+# magic, version, size and mtime of the dump, number of sections
+HEADER = struct.Struct('<8siqdi')
+# name (AT MOST 32 BYTES), offset, length
+SECTION = struct.Struct('<32sqq')
+
+TOKEN_STRING_FIELDS = ('Id', 'str', 'scopeId', 'linkId', 'varId', 'variableId', 'functionId',
+                       'typeScopeId', 'astParentId', 'astOperand1Id', 'astOperand2Id',
+                       'file', 'linenr', 'unitType')
+TOKEN_FLAG_FIELDS = ('isName', 'isNumber', 'isInt', 'isFloat', 'isString', 'isChar', 'isOp',
+                     'isArithmeticalOp', 'isAssignmentOp', 'isComparisonOp', 'isLogicalOp')
+TOKEN_REF_FIELDS = ('scope', 'link', 'variable', 'function', 'typeScope',
+                    'astParent', 'astOperand1', 'astOperand2')
+
+SCOPE_STRING_FIELDS = ('Id', 'className', 'classStartId', 'classEndId', 'nestedInId', 'type', 'functionId')
+SCOPE_REF_FIELDS = ('classStart', 'classEnd', 'nestedIn', 'function')
+
+FUNCTION_STRING_FIELDS = ('Id', 'tokenDefId', 'name')
+FUNCTION_REF_FIELDS = ('tokenDef',)
+
+VARIABLE_STRING_FIELDS = ('Id', 'nameTokenId', 'typeStartTokenId', 'typeEndTokenId')
+VARIABLE_FLAG_FIELDS = ('isArgument', 'isArray', 'isClass', 'isLocal', 'isPointer', 'isReference', 'isStatic')
+VARIABLE_REF_FIELDS = ('nameToken', 'typeStartToken', 'typeEndToken')
+
+
+def get_image_file(dump_file):
+    return dump_file + IMAGE_SUFFIX
+
+
+def load_first_configuration(dump_file):
+    ''' THE FIRST CONFIGURATION OF A DUMP, FROM ITS IMAGE WHEN THE IMAGE MATCHES THE DUMP.
+        OTHERWISE PARSE THE DUMP AND WRITE THE IMAGE FOR THE NEXT LOAD (A FAILED WRITE IS REPORTED
+        AND THE PARSED DUMP IS STILL RETURNED)
+        input: path to a cppcheck dump file
+        returns: cppcheckdata.CppcheckData with at most one configuration
+        '''
+    image_file = get_image_file(dump_file)
+    data = read_image(image_file, dump_file)
+    if data is not None:
+        return data
+    data = cppcheckdata.parsedump_streaming(dump_file, 0)
+    if data.configurations:
+        try:
+            write_image(data.configurations[0], image_file, dump_file)
+        except (IOError, OSError) as e:
+            eprint('could not write dump image %s: %s' % (image_file, e))
+    return data
+
+
+def eprint(*args, **kwargs):
+    print(*args, file=sys.stderr, **kwargs)
+
+
+def get_dump_stamp(dump_file):
+    ''' THE IMAGE IS KEYED ON THE SIZE AND MTIME OF THE DUMP, A stat() INSTEAD OF A READ OF THE WHOLE DUMP.
+        A DUMP THE DRIVER REGENERATES GETS A NEW MTIME AND THEREFORE A NEW IMAGE
+        returns: tuple (size, mtime) of the dump file
+        '''
+    st = os.stat(dump_file)
+    return (st.st_size, st.st_mtime)
+
+
+# - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+# WRITE
+# - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+def write_image(cppcheck_configuration, image_file, dump_file):
+    ''' input: a parsed Configuration (BEFORE OR AFTER ANALYSIS, ONLY PARSED FIELDS ARE WRITTEN),
+               the image path and the dump it was parsed from
+        '''
+    c = cppcheck_configuration
+    string2index = {}
+    strings = []
+
+    def string_index(s):
+        if s is None:
+            return -1
+        i = string2index.get(s)
+        if i is None:
+            i = len(strings)
+            string2index[s] = i
+            strings.append(s)
+        return i
+
+    obj2index = {}
+    for obj in c.tokenlist + c.scopes + c.functions + c.variables:
+        obj2index[id(obj)] = len(obj2index)
+
+    def ref_index(obj):
+        if obj is None:
+            return -1
+        return obj2index[id(obj)]
+
+    sections = [('name', array('i', [string_index(c.name)]))]
+
+    def add_columns(prefix, objs, string_fields, ref_fields, flag_fields=()):
+        for name in string_fields:
+            sections.append((prefix + name, array('i', [string_index(getattr(o, name, None)) for o in objs])))
+        for name in ref_fields:
+            sections.append((prefix + name, array('i', [ref_index(getattr(o, name, None)) for o in objs])))
+        if flag_fields:
+            flags = array('i', [0] * len(objs))
+            for (bit, name) in enumerate(flag_fields):
+                for (i, o) in enumerate(objs):
+                    if getattr(o, name, False):
+                        flags[i] |= 1 << bit
+            sections.append((prefix + 'flags', flags))
+
+    add_columns('t.', c.tokenlist, TOKEN_STRING_FIELDS, TOKEN_REF_FIELDS, TOKEN_FLAG_FIELDS)
+    sections.append(('t.strlen', array('i', [-1 if t.strlen is None else t.strlen for t in c.tokenlist])))
+    add_columns('s.', c.scopes, SCOPE_STRING_FIELDS, SCOPE_REF_FIELDS)
+    add_columns('f.', c.functions, FUNCTION_STRING_FIELDS, FUNCTION_REF_FIELDS)
+    add_columns('v.', c.variables, VARIABLE_STRING_FIELDS, VARIABLE_REF_FIELDS, VARIABLE_FLAG_FIELDS)
+
+    # FUNCTION ARGUMENTS:  f.args[i]:f.args[i + 1] ARE THE ARGUMENTS OF FUNCTION i
+    arg_starts = array('i', [0])
+    arg_nrs = array('i')
+    arg_variable_ids = array('i')
+    arg_variables = array('i')
+    for f in c.functions:
+        for (nr, variable_id) in f.argumentId.items():
+            arg_nrs.append(string_index(nr))
+            arg_variable_ids.append(string_index(variable_id))
+            arg_variables.append(ref_index(f.argument.get(nr)))
+        arg_starts.append(len(arg_nrs))
+    sections.extend([('f.args', arg_starts), ('a.nr', arg_nrs),
+                     ('a.variableId', arg_variable_ids), ('a.variable', arg_variables)])
+
+    # STRING TABLE:  UTF-8 BLOB AND OFFSETS
+    encoded = [s.encode('utf-8') for s in strings]
+    offsets = array('i', [0])
+    for s in encoded:
+        offsets.append(offsets[-1] + len(s))
+    sections.append(('strings', offsets))
+
+    blobs = [(name, column.tostring()) for (name, column) in sections]
+    blobs.append(('blob', ''.join(encoded)))
+
+    (dump_size, dump_mtime) = get_dump_stamp(dump_file)
+    offset = HEADER.size + SECTION.size * len(blobs)
+    directory = []
+    for (name, blob) in blobs:
+        directory.append(SECTION.pack(name, offset, len(blob)))
+        offset += len(blob)
+
+    # WRITE TO A TEMP NAME FIRST, PARALLEL WORKERS MAY RACE
+    tmp_file = '%s.%d.tmp' % (image_file, os.getpid())
+    with open(tmp_file, 'wb') as f:
+        f.write(HEADER.pack(IMAGE_MAGIC, IMAGE_FORMAT_VERSION, dump_size, dump_mtime, len(blobs)))
+        f.write(''.join(directory))
+        for (name, blob) in blobs:
+            f.write(blob)
+    os.rename(tmp_file, image_file)
+
+
+# - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+# READ
+# - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+def read_image(image_file, dump_file=None):
+    ''' input: image path, and the dump it must match (None:  do not check)
+        returns: cppcheckdata.CppcheckData, or None if there is no usable image
+        '''
+    if not os.path.exists(image_file):
+        return None
+    try:
+        with open(image_file, 'rb') as f:
+            mapped = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+        # MILLIONS OF NEW OBJECTS, NONE OF THEM GARBAGE:  DO NOT LET THE CYCLE COLLECTOR RESCAN THEM
+        gc_was_enabled = gc.isenabled()
+        gc.disable()
+        try:
+            return read_mapped_image(mapped, dump_file)
+        finally:
+            mapped.close()
+            if gc_was_enabled:
+                gc.enable()
+    except (IOError, OSError, ValueError, KeyError, struct.error):
+        # TRUNCATED OR FOREIGN FILE, TREAT AS A MISS
+        return None
+
+
+def read_mapped_image(mapped, dump_file):
+    (magic, version, dump_size, dump_mtime, nr_sections) = HEADER.unpack_from(mapped, 0)
+    if magic != IMAGE_MAGIC or version != IMAGE_FORMAT_VERSION:
+        return None
+    if dump_file and get_dump_stamp(dump_file) != (dump_size, dump_mtime):
+        return None
+
+    sections = {}
+    for i in range(nr_sections):
+        (name, offset, length) = SECTION.unpack_from(mapped, HEADER.size + SECTION.size * i)
+        sections[name.rstrip('\0')] = (offset, length)
+
+    def column(name):
+        (offset, length) = sections[name]
+        a = array('i')
+        a.fromstring(mapped[offset:offset + length])
+        return a
+
+    offsets = column('strings')
+    (blob_offset, blob_length) = sections['blob']
+    blob = mapped[blob_offset:blob_offset + blob_length]
+    strings = [decode(blob[offsets[i]:offsets[i + 1]]) for i in xrange(len(offsets) - 1)]
+    # INDEX -1 IS None
+    strings.append(None)
+
+    c = cppcheckdata.Configuration()
+    c.name = strings[column('name')[0]]
+    nr_tokens = len(column('t.Id'))
+    c.tokenlist = [object.__new__(cppcheckdata.SlotToken) for i in xrange(nr_tokens)]
+    c.scopes = [types.InstanceType(cppcheckdata.Scope, {}) for i in xrange(len(column('s.Id')))]
+    c.functions = [types.InstanceType(cppcheckdata.Function, {}) for i in xrange(len(column('f.Id')))]
+    c.variables = [types.InstanceType(cppcheckdata.Variable, {}) for i in xrange(len(column('v.Id')))]
+    objs = c.tokenlist + c.scopes + c.functions + c.variables
+    # INDEX -1 IS None
+    objs.append(None)
+
+    def set_columns(prefix, items, string_fields, ref_fields, flag_fields=()):
+        for name in string_fields:
+            for (item, i) in izip(items, column(prefix + name)):
+                setattr(item, name, strings[i])
+        for name in ref_fields:
+            for (item, i) in izip(items, column(prefix + name)):
+                setattr(item, name, objs[i])
+        if flag_fields:
+            flags = column(prefix + 'flags')
+            for (bit, name) in enumerate(flag_fields):
+                mask = 1 << bit
+                for (item, f) in izip(items, flags):
+                    setattr(item, name, (f & mask) != 0)
+
+    tokens = c.tokenlist
+    set_columns('t.', tokens, TOKEN_STRING_FIELDS, TOKEN_REF_FIELDS, TOKEN_FLAG_FIELDS)
+    for (t, n) in izip(tokens, column('t.strlen')):
+        t.strlen = None if n < 0 else n
+    previous = None
+    for t in tokens:
+        t.previous = previous
+        t.next = None
+        t.valuesId = None
+        t.values = None
+        if t.unitType is None:
+            # Token ONLY HAS unitType WHEN THE DUMP HAS ONE
+            del t.unitType
+        if previous:
+            previous.next = t
+        previous = t
+
+    set_columns('s.', c.scopes, SCOPE_STRING_FIELDS, SCOPE_REF_FIELDS)
+    for s in c.scopes:
+        # SAME AS Scope.setId
+        if s.nestedIn:
+            s.foo = s.nestedInId
+        else:
+            s.bar = s.nestedInId
+
+    set_columns('f.', c.functions, FUNCTION_STRING_FIELDS, FUNCTION_REF_FIELDS)
+    (arg_starts, arg_nrs, arg_variable_ids, arg_variables) = (column('f.args'), column('a.nr'),
+                                                              column('a.variableId'), column('a.variable'))
+    for (fi, f) in enumerate(c.functions):
+        f.argumentId = {}
+        f.argument = {}
+        for ai in xrange(arg_starts[fi], arg_starts[fi + 1]):
+            nr = strings[arg_nrs[ai]]
+            f.argumentId[nr] = strings[arg_variable_ids[ai]]
+            f.argument[nr] = objs[arg_variables[ai]]
+
+    set_columns('v.', c.variables, VARIABLE_STRING_FIELDS, VARIABLE_REF_FIELDS, VARIABLE_FLAG_FIELDS)
+
+    data = cppcheckdata.CppcheckData()
+    data.configurations.append(c)
+    return data
+
+
+def decode(s):
+    ''' ASCII STAYS A str, AS FROM THE XML PARSER
+        '''
+    try:
+        s.decode('ascii')
+        return s
+    except UnicodeDecodeError:
+        return s.decode('utf-8')
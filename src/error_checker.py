@@ -5,17 +5,29 @@ from unit_error_types import UnitErrorTypes
 from tree_walker import TreeWalker
 from symbol_helper import SymbolHelper
 import cps_constraints as con
+import phys_unit
 import os.path
 from operator import itemgetter
 import copy
-import cppcheckdata
+from analysis_state import AnalysisState, get_token_index
 
 
 class ErrorChecker:
     ''' IMPLEMENTATION OF MAIN ERROR CHECKING
     '''
 
-    def __init__(self, dump_file, source_file): 
+    ERROR_TYPE_TEXT = [             # MUST BE SAME INDEX AS UnitErrorTypes
+                       'VARIABLE_MULTIPLE_UNITS',
+                       'COMPARISON_INCOMPATIBLE_UNITS',
+                       'VARIABLE_BECAME_UNITLESS',
+                       'FUNCTION_CALLED_WITH_DIFFERENT_UNIT_ARGUMENTS',
+                       'VARIABLE_WITH_UNUSUAL_UNITS',
+                       'ADDITION_OF_INCOMPATIBLE_UNITS',
+                       'LOGICAL_OPERATOR_USED_ON_UNITS',
+                       'UNIT_SMELL',
+                      ]
+
+    def __init__(self, dump_file, source_file, constraint_store=None): 
         self.dump_file = dump_file 
         self.current_file_under_analysis = ''
 	self.source_file = source_file
@@ -24,7 +36,8 @@ class ErrorChecker:
         self.prepare_source_file_for_reading()
         self.all_errors = []
         #self.all_warnings = []
-        self.symbol_helper = SymbolHelper()
+        self.con = constraint_store if constraint_store is not None else con.ConstraintStore()
+        self.symbol_helper = SymbolHelper(self.con)
         self.have_found_addition_error_on_this_line = False
         self.marked_as_low_confidence = []
         self.variable_units_to_check = {}
@@ -75,7 +88,7 @@ class ErrorChecker:
             returns: none
             side_effects: might add UnitError objects to self.all_errors list
             '''
-        for root_token, token, name, units, isKnownRhs in con.multi_unit_variables:
+        for root_token, token, name, units, isKnownRhs in self.con.multi_unit_variables:
             new_error = UnitError()   
             new_error.ERROR_TYPE = UnitErrorTypes.VARIABLE_MULTIPLE_UNITS
             new_error.linenr = token.linenr
@@ -159,7 +172,7 @@ class ErrorChecker:
             side_effects: might add UnitError objects to self.all_errors list
             '''            
         for function_dict in sorted_analysis_unit_dict.values():
-            tw = TreeWalker(None)
+            tw = TreeWalker(None, None, self.con)
             for root_token in function_dict['root_tokens']:
                 self.have_found_addition_error_on_this_line = False
                 tw.generic_recurse_and_apply_function(root_token, self.error_check_addition_of_incompatible_units_recursive)
@@ -215,7 +228,7 @@ class ErrorChecker:
             side_effects: might add UnitError objects to self.all_errors list
             '''            
         for function_dict in sorted_analysis_unit_dict.values():
-            tw = TreeWalker(None)
+            tw = TreeWalker(None, None, self.con)
             for root_token in function_dict['root_tokens']:
                 tw.generic_recurse_and_apply_function(root_token, self.error_check_comparison_recursive)
 
@@ -266,7 +279,7 @@ class ErrorChecker:
             side_effects: might add UnitError objects to self.all_errors list
             '''
         for function_dict in sorted_analysis_unit_dict.values():
-            tw = TreeWalker(None)
+            tw = TreeWalker(None, None, self.con)
             for root_token in function_dict['root_tokens']:
                 tw.generic_recurse_and_apply_function(root_token, self.error_check_logical_recursive)
 
@@ -297,11 +310,11 @@ class ErrorChecker:
 
 
     def check_if_error_with_low_confidence(self, token, left_token, right_token):
-        #con.FOUND_DERIVED_CU_VARIABLE = False
+        #self.con.FOUND_DERIVED_CU_VARIABLE = False
 
         #units = self.get_left_right_units(token, left_token, right_token)
 
-        #if con.FOUND_DERIVED_CU_VARIABLE:
+        #if self.con.FOUND_DERIVED_CU_VARIABLE:
         #    if len(units) > 2:
         #        return True
         #elif units:
@@ -318,9 +331,9 @@ class ErrorChecker:
 
         if left_token:
             if left_token.str in ['*', '/'] and left_token.astOperand1 and left_token.astOperand2:
-                if left_token.astOperand1.units == [{'nounit': 0.0}]:
+                if left_token.astOperand1.units == [phys_unit.NOUNIT]:
                     left_token = left_token.astOperand2
-                elif left_token.astOperand2.units == [{'nounit': 0.0}]:
+                elif left_token.astOperand2.units == [phys_unit.NOUNIT]:
                     left_token = left_token.astOperand1
 
             if left_token.str in ['+', '-', '*', '/']:
@@ -331,21 +344,21 @@ class ErrorChecker:
                 if left_token.str == '.' or left_token.str == '[':
                     (left_token, left_name) = self.symbol_helper.find_compound_variable_and_name_for_dot_operand(left_token)
 
-                if (left_token.variable, left_name) in con.variable2unitproba:
+                if (left_token.variable, left_name) in self.con.variable2unitproba:
                     n = 3
-                    if con.is_only_known_unit_variable(left_token.variable, left_name):
+                    if self.con.is_only_known_unit_variable(left_token.variable, left_name):
                         n = 1
-                    left_units = con.variable2unitproba[(left_token.variable, left_name)][:n]
-                    left_units = filter(lambda (u, p): p > con.unit_prob_threshold, left_units)
+                    left_units = self.con.variable2unitproba[(left_token.variable, left_name)][:n]
+                    left_units = filter(lambda (u, p): p > self.con.unit_prob_threshold, left_units)
                     left_units = map(lambda (u, p): u, left_units)
-                    if con.ENABLE_UNIT_LIST_FLATTENING:
-                        left_units = con.flatten_unit_list(left_units)
+                    if self.con.ENABLE_UNIT_LIST_FLATTENING:
+                        left_units = self.con.flatten_unit_list(left_units)
 
         if right_token:
             if right_token.str in ['*', '/'] and right_token.astOperand1 and right_token.astOperand2:
-                if right_token.astOperand1.units == [{'nounit': 0.0}]:
+                if right_token.astOperand1.units == [phys_unit.NOUNIT]:
                     right_token = right_token.astOperand2
-                elif right_token.astOperand2.units == [{'nounit': 0.0}]:
+                elif right_token.astOperand2.units == [phys_unit.NOUNIT]:
                     right_token = right_token.astOperand1
 
             if right_token.str in ['+', '-', '*', '/']:
@@ -356,15 +369,15 @@ class ErrorChecker:
                 if right_token.str == '.' or right_token.str == '[':
                     (right_token, right_name) = self.symbol_helper.find_compound_variable_and_name_for_dot_operand(right_token)
 
-                if (right_token.variable, right_name) in con.variable2unitproba:
+                if (right_token.variable, right_name) in self.con.variable2unitproba:
                     n = 3
-                    if con.is_only_known_unit_variable(right_token.variable, right_name):
+                    if self.con.is_only_known_unit_variable(right_token.variable, right_name):
                         n = 1
-                    right_units = con.variable2unitproba[(right_token.variable, right_name)][:n]
-                    right_units = filter(lambda (u, p): p > con.unit_prob_threshold, right_units)
+                    right_units = self.con.variable2unitproba[(right_token.variable, right_name)][:n]
+                    right_units = filter(lambda (u, p): p > self.con.unit_prob_threshold, right_units)
                     right_units = map(lambda (u, p): u, right_units)
-                    if con.ENABLE_UNIT_LIST_FLATTENING:
-                        right_units = con.flatten_unit_list(right_units)
+                    if self.con.ENABLE_UNIT_LIST_FLATTENING:
+                        right_units = self.con.flatten_unit_list(right_units)
         
         if not left_units:
             return right_units
@@ -372,7 +385,7 @@ class ErrorChecker:
             return left_units
         else:
             if token.str in ['*', '/']:
-                tw = TreeWalker(None)
+                tw = TreeWalker(None, None, self.con)
                 all_unit_dicts_from_multiplication = []
                 for unit_dict_left in left_units:
                     for unit_dict_right in right_units:
@@ -394,77 +407,24 @@ class ErrorChecker:
 
     
     def check_errors_with_low_confidence_when_top3_units(self, cppcheck_configuration_unit, sorted_analysis_unit_dict):
-        # need to work on another copy of cppcheckdata
+        # need to work on another copy of the analysis state
         # check after all errors are collected
 
-        con.print_known_unit_variables()
-  
-        data = cppcheckdata.parsedump(self.dump_file)
-        for c in data.configurations[:1]:
-            break
+        self.con.print_known_unit_variables()
 
-        # copy token and function data from original config
-        tokenlist = {}
+        # SAME TOKENS, FRESH UNITS.  THE UNITS OF THE MAIN ANALYSIS ARE PUT BACK AFTERWARDS
+        analysis_state = AnalysisState(cppcheck_configuration_unit)
+        analysis_state.fork()
+        try:
+            self.check_errors_with_top3_units_on_fork(cppcheck_configuration_unit, sorted_analysis_unit_dict)
+        finally:
+            analysis_state.restore()
 
-        for t in cppcheck_configuration_unit.tokenlist:
-            tokenlist[t.Id] = (t.isRoot, t.isDimensionless)
-
-        functionlist = {}
-        returnexprtokenlist = {}
-
-        for f in cppcheck_configuration_unit.functions:
-            functionlist[f.Id] = (f.return_units, f.arg_units, f.return_arg_var_nr,
-                                  f.return_expr_root_token,
-                                  f.is_unit_propagation_based_on_constants,
-                                  f.is_unit_propagation_based_on_unknown_variable,
-                                  f.is_unit_propagation_based_on_weak_inference,
-                                  f.maybe_generic_function)
-
-            if f.return_expr_root_token:
-                returnexprtokenlist[f.return_expr_root_token.Id] = None 
-
-
-        returntokenlist = {}
-
-        for t in c.tokenlist:
-            (isRoot, isDimensionless) = tokenlist[t.Id]
-
-            t.units = []
-            t.isKnown = False
-            t.is_unit_propagation_based_on_constants = False
-            t.is_unit_propagation_based_on_unknown_variable = False
-            t.is_unit_propagation_based_on_weak_inference = False
-            t.isRoot = isRoot
-            t.isDimensionless = isDimensionless
-
-            if t.str == "return":
-                returntokenlist[t.Id] = t
-
-            if t.Id in returnexprtokenlist:
-                returnexprtokenlist[t.Id] = t
-
-        for f in c.functions:
-            (return_units, arg_units, return_arg_var_nr, 
-             return_expr_root_token, 
-             is_unit_propagation_based_on_constants,
-             is_unit_propagation_based_on_unknown_variable,
-             is_unit_propagation_based_on_weak_inference,
-             maybe_generic_function) = functionlist[f.Id]
-
-            if return_expr_root_token:
-                return_expr_root_token = returnexprtokenlist[return_expr_root_token.Id]
-
-            f.return_units = [] #return_units
-            f.arg_units = [] #arg_units
-            f.return_arg_var_nr = return_arg_var_nr
-            f.return_expr_root_token = return_expr_root_token
-            f.is_unit_propagation_based_on_constants = is_unit_propagation_based_on_constants
-            f.is_unit_propagation_based_on_unknown_variable = is_unit_propagation_based_on_unknown_variable
-            f.is_unit_propagation_based_on_weak_inference = is_unit_propagation_based_on_weak_inference
-            f.maybe_generic_function = maybe_generic_function
-            for arg_number in f.argument.keys():
-                f.arg_units.append([])
 
+    def check_errors_with_top3_units_on_fork(self, c, sorted_analysis_unit_dict):
+        ''' input: Configuration between AnalysisState.fork() and restore()
+            '''
+        id2token = get_token_index(c)
 
         # collect return units of all functions
         returnlist = {}
@@ -481,7 +441,7 @@ class ErrorChecker:
 
             for root_token in function_dict['root_tokens']:
                 if root_token.str == 'return':
-                    t = returntokenlist[root_token.Id]
+                    t = root_token
 
                     self.check_error_when_top3_units(t)
 
@@ -491,7 +451,7 @@ class ErrorChecker:
                             if u not in returnlist[function_dict['scopeObject'].function.Id]:
                                 returnlist[function_dict['scopeObject'].function.Id].append(u)
                         
-                    tw = TreeWalker(None)
+                    tw = TreeWalker(None, None, self.con)
                     tw.generic_recurse_and_apply_function(t, tw.reset_tokens)
 
         for f in c.functions:
@@ -502,7 +462,7 @@ class ErrorChecker:
         
         # check all errors
         for e in self.all_errors:
-            con.FOUND_DERIVED_CU_VARIABLE = False
+            self.con.FOUND_DERIVED_CU_VARIABLE = False
 
             if e.is_warning:
                 continue
@@ -513,19 +473,14 @@ class ErrorChecker:
             if e.ERROR_TYPE == UnitErrorTypes.ADDITION_OF_INCOMPATIBLE_UNITS or \
                     e.ERROR_TYPE == UnitErrorTypes.COMPARISON_INCOMPATIBLE_UNITS:
 
-                root_token = None
-                # find token in the copy
-                for t in c.tokenlist:
-                    if t.Id == e.token.Id:
-                        root_token = t
-                        break
+                root_token = id2token.get(e.token.Id)
                 if not root_token:
                     continue
 
                 self.check_error_when_top3_units(root_token)
 
                 if e.ERROR_TYPE == UnitErrorTypes.ADDITION_OF_INCOMPATIBLE_UNITS:
-                    if con.FOUND_DERIVED_CU_VARIABLE:
+                    if self.con.FOUND_DERIVED_CU_VARIABLE:
                         if len(root_token.units) > 2:
                             e.is_warning = True
                     elif root_token.units:
@@ -545,30 +500,19 @@ class ErrorChecker:
                                 if lu in right_units:
                                     units.append(lu)
                     
-                    if con.FOUND_DERIVED_CU_VARIABLE:
+                    if self.con.FOUND_DERIVED_CU_VARIABLE:
                         if len(units) > 2:
                             e.is_warning = True
                     elif units:
                         e.is_warning = True
 
-                tw = TreeWalker(None)
+                tw = TreeWalker(None, None, self.con)
                 tw.generic_recurse_and_apply_function(root_token, tw.reset_tokens)
 
             elif e.ERROR_TYPE == UnitErrorTypes.VARIABLE_MULTIPLE_UNITS:
                 
-                i = 0
-                root_token = None
-                left_token = None
-                # find token in the copy
-                for t in c.tokenlist:
-                    if t.Id == e.token.Id:
-                        root_token = t
-                        i = i + 1
-                    elif t.Id == e.token_left.Id:
-                        left_token = t
-                        i = i + 1
-                    if i == 2:
-                        break
+                root_token = id2token.get(e.token.Id)
+                left_token = id2token.get(e.token_left.Id)
                 if (not root_token) or (not left_token):
                     continue
                 elif not root_token.astOperand2:
@@ -580,7 +524,7 @@ class ErrorChecker:
                 self.check_error_when_top3_units(root_token.astOperand2)
 
                 if (not left_token.isKnown): #and root_token.astOperand2.units:
-                    if con.FOUND_DERIVED_CU_VARIABLE:
+                    if self.con.FOUND_DERIVED_CU_VARIABLE:
                         if len(root_token.astOperand2.units) > 2:
                             e.is_warning = True
                     elif root_token.astOperand2.units:
@@ -595,32 +539,32 @@ class ErrorChecker:
                             if lu in root_token.astOperand2.units:
                                 units.append(lu)
                         
-                        if con.FOUND_DERIVED_CU_VARIABLE:
+                        if self.con.FOUND_DERIVED_CU_VARIABLE:
                             if len(units) > 2:
                                 e.is_warning = True
                         elif units:
                             e.is_warning = True
                         
  
-                    #if not con.is_df_constraint_present(e.token_left, e.var_name):
+                    #if not self.con.is_df_constraint_present(e.token_left, e.var_name):
                     #    if root_token.astOperand2.units: #and (root_token.astOperand1.units == root_token.astOperand2.units):
                     #        units = []
                     #        for lu in root_token.astOperand1.units:
                     #            if lu in root_token.astOperand2.units:
                     #                units.append(lu)
                         
-                    #        if con.FOUND_DERIVED_CU_VARIABLE:
+                    #        if self.con.FOUND_DERIVED_CU_VARIABLE:
                     #            if len(units) > 2:
                     #                e.is_warning = True
                     #        elif units:
                     #            e.is_warning = True
 
-                tw = TreeWalker(None)
+                tw = TreeWalker(None, None, self.con)
                 tw.generic_recurse_and_apply_function(root_token, tw.reset_tokens)
 
 
     def check_error_when_top3_units(self, root_token):
-        tw = TreeWalker(None)  
+        tw = TreeWalker(None, None, self.con)  
 
         # ASSUME THE TOKENS COME BACK AS A SORTED LIST
         break_point = 1000
@@ -665,31 +609,12 @@ class ErrorChecker:
             # LOOK FOR EARLY ABANDONMENT OF THIS AST
             if not tw.found_units_in_this_tree:
                 break
-            ### PROPAGATE UNITS
-            tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_across_dot_connectors)
-            tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_across_double_colon)                
-            tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_across_square_brackets)
-            tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_across_assignment)
-            tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_math_abs_fabs_floor_ceil)
-            tw.perform_intersection = True
-            tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_math_min_max)
-            tw.perform_intersection = False
-            tw.perform_intersection = True
-            tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_math_fmod_fmodf_fmodl)
-            tw.perform_intersection = False
-            tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_sqrt)
-            # tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_getXYZ)
-            tw.perform_intersection = True
-            tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_ternary)
-            tw.perform_intersection = False
-            tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_pow)
-            tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_inverse_trig)
-            tw.perform_intersection = True
-            tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_across_operators)
-            tw.perform_intersection = False
-            tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_across_return)
-            tw.generic_recurse_and_apply_function(root_token, tw.collect_function_param_units_and_decorate_function)
-            tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_across_parenthesis)
+            ### PROPAGATE UNITS  (INTERSECT, INSTEAD OF UNITE, THE UNITS OF OPERANDS)
+            tw.propagate_units_one_round(root_token, 
+                                         intersection_rules=['propagate_units_math_min_max', 
+                                                             'propagate_units_math_fmod_fmodf_fmodl', 
+                                                             'propagate_units_ternary', 
+                                                             'propagate_units_across_operators'])
         # END -- WHILE LOOP
 
 
@@ -718,17 +643,8 @@ class ErrorChecker:
 
 
     def print_unit_errors(self, errors_file, show_high_confidence=True, show_low_confidence=False):
-        error_type_text = [
-                           'VARIABLE_MULTIPLE_UNITS',
-                           'COMPARISON_INCOMPATIBLE_UNITS',
-                           'VARIABLE_BECAME_UNITLESS',
-                           'FUNCTION_CALLED_WITH_DIFFERENT_UNIT_ARGUMENTS',
-                           'VARIABLE_WITH_UNUSUAL_UNITS',
-                           'ADDITION_OF_INCOMPATIBLE_UNITS',
-                           'LOGICAL_OPERATOR_USED_ON_UNITS',
-                           'UNIT_SMELL',
-                          ]
-        tw = TreeWalker(None)
+        error_type_text = self.ERROR_TYPE_TEXT
+        tw = TreeWalker(None, None, self.con)
 
         with open(errors_file, 'w') as f:
             for e in self.all_errors:
@@ -758,10 +674,10 @@ class ErrorChecker:
             value = self.variable_units_to_check[(var, var_name)]
             isKnown = value[0]
             rank = 1.0
-            if (var, var_name) in con.variable2unitproba:
-                if len(con.variable2unitproba[(var, var_name)]) >= 2:
-                    unit, proba = con.variable2unitproba[(var, var_name)][0]
-                    unit2, proba2 = con.variable2unitproba[(var, var_name)][1]
+            if (var, var_name) in self.con.variable2unitproba:
+                if len(self.con.variable2unitproba[(var, var_name)]) >= 2:
+                    unit, proba = self.con.variable2unitproba[(var, var_name)][0]
+                    unit2, proba2 = self.con.variable2unitproba[(var, var_name)][1]
                     rank = proba - proba2
             self.variable_units_to_check_as_list.append((isKnown, rank, var, var_name, value[1], value[2]))
         self.variable_units_to_check_as_list = sorted(self.variable_units_to_check_as_list, key=itemgetter(0, 1))
@@ -2,7 +2,9 @@ from unit_error_types import UnitErrorTypes
 from error_checker import ErrorChecker
 from tree_walker import TreeWalker
 import cps_constraints as con
-import cppcheckdata
+import phys_unit
+import dump_image
+from analysis_state import get_token_index
 import pickle
 import os
 from operator import itemgetter
@@ -13,7 +15,8 @@ class ErrorRechecker:
     ''' IMPLEMENTATION OF USER-ASSISTED ERROR RECHECKING
     '''
 
-    def __init__(self):
+    def __init__(self, constraint_store=None):
+        self.con = constraint_store if constraint_store is not None else con.ConstraintStore()
         self.cppcheck_pkl_filename = 'cppcheck_config.pkl'
         self.errors_pkl_filename = 'error_list.pkl'
         self.varlist_pkl_filename = 'var_units_to_check_list.pkl'
@@ -45,7 +48,7 @@ class ErrorRechecker:
 
 
     def get_cppcheck_config_data_structure(self, dump_file):
-        data = cppcheckdata.parsedump(dump_file)
+        data = dump_image.load_first_configuration(dump_file)
         for c in data.configurations[:1]:
             return c
 
@@ -77,14 +80,13 @@ class ErrorRechecker:
 
         errors = pickle.load(open(self.errors_pkl_filename, 'rb'))
 
-        for t in a_cppcheck_configuration.tokenlist:
-            for e in errors:
-                if e.token == t.Id:
-                    e.token = t
-                if e.token_left and e.token_left == t.Id:
-                    e.token_left = t
-                if e.token_right and e.token_right == t.Id:
-                    e.token_right = t    
+        id2token = get_token_index(a_cppcheck_configuration)
+        for e in errors:
+            e.token = id2token.get(e.token, e.token)
+            if e.token_left:
+                e.token_left = id2token.get(e.token_left, e.token_left)
+            if e.token_right:
+                e.token_right = id2token.get(e.token_right, e.token_right)
 
         varlist = pickle.load(open(self.varlist_pkl_filename, 'rb'))
 
@@ -112,22 +114,8 @@ class ErrorRechecker:
             if not tw.found_units_in_this_tree:
                 break
             ### PROPAGATE UNITS
-            tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_across_dot_connectors)
-            tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_across_double_colon)                
-            tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_across_square_brackets)
-            tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_across_assignment)
-            tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_math_abs_fabs_floor_ceil)
-            tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_math_min_max)
-            tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_math_fmod_fmodf_fmodl)
-            tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_sqrt)
-            # tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_getXYZ)
-            tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_ternary)
-            tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_pow)
-            tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_inverse_trig)
-            tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_across_operators)
-            tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_across_return)
-            # tw.generic_recurse_and_apply_function(root_token, tw.collect_function_param_units_and_decorate_function)
-            tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_across_parenthesis)
+            tw.propagate_units_one_round(root_token, 
+                                         skipped_rules=['collect_function_param_units_and_decorate_function'])
         # END -- WHILE LOOP    
  
 
@@ -136,15 +124,15 @@ class ErrorRechecker:
             for var_result in (line.rstrip('\n') for line in f):
                 var_name, var_unit = var_result.split(',', 1)
                 var_name, var_unit = var_name.strip(), var_unit.strip()
-                var_unit = eval(var_unit) 
-                con.phys_corrections[var_name] = var_unit
+                var_unit = phys_unit.make_unit_list(eval(var_unit))
+                self.con.phys_corrections[var_name] = var_unit
 
-        #print "phys_corrections: %s" % con.phys_corrections
+        #print "phys_corrections: %s" % self.con.phys_corrections
 
         a_cppcheck_configuration = self.get_cppcheck_config_data_structure(dump_file)
         errors, varlist = self.load_state(a_cppcheck_configuration)
 
-        err_checker = ErrorChecker(dump_file, source_file)
+        err_checker = ErrorChecker(dump_file, source_file, self.con)
         show_high_confidence=True 
         show_low_confidence=False
 
@@ -158,7 +146,7 @@ class ErrorRechecker:
                 continue
 
             if e.ERROR_TYPE == UnitErrorTypes.VARIABLE_MULTIPLE_UNITS:
-                tw = TreeWalker(None)
+                tw = TreeWalker(None, None, self.con)
                 self.apply_and_propagate_units(tw, e.token)
 
                 # TRACK VARIABLE WITH MULTIPLE UNITS
@@ -176,7 +164,7 @@ class ErrorRechecker:
                         err_checker.all_errors.append(e)
 
             elif e.ERROR_TYPE == UnitErrorTypes.FUNCTION_CALLED_WITH_DIFFERENT_UNIT_ARGUMENTS:
-                tw = TreeWalker(None)
+                tw = TreeWalker(None, None, self.con)
                 self.apply_and_propagate_units(tw, e.token_left)
                 self.apply_and_propagate_units(tw, e.token_right)
             
@@ -189,13 +177,13 @@ class ErrorRechecker:
                     err_checker.all_errors.append(e)
 
             elif e.ERROR_TYPE == UnitErrorTypes.ADDITION_OF_INCOMPATIBLE_UNITS:
-                tw = TreeWalker(None)
+                tw = TreeWalker(None, None, self.con)
                 self.apply_and_propagate_units(tw, e.token)
                 err_checker.have_found_addition_error_on_this_line = False
                 tw.generic_recurse_and_apply_function(e.token, err_checker.error_check_addition_of_incompatible_units_recursive)
 
             elif e.ERROR_TYPE == UnitErrorTypes.COMPARISON_INCOMPATIBLE_UNITS:
-                tw = TreeWalker(None)
+                tw = TreeWalker(None, None, self.con)
                 self.apply_and_propagate_units(tw, e.token)
                 tw.generic_recurse_and_apply_function(e.token, err_checker.error_check_comparison_recursive)
 
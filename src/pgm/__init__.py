@@ -3,6 +3,7 @@
 # Created by Zhaogui Xu on 8/12/16
 
 
-from pgm import Variable, Factor, FactorGraph, PGMEngine
+from pgm import Variable, Factor, FactorGraph, PGMEngine, is_dai_available
+from edge_bp import EdgeBPEngine
 
-__all__ = ['Variable', 'Factor', 'FactorGraph', 'PGMEngine']
+__all__ = ['Variable', 'Factor', 'FactorGraph', 'PGMEngine', 'EdgeBPEngine', 'is_dai_available']
@@ -0,0 +1,166 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+
+# SHRINK THE FACTORS OF A GRAPH BEFORE INFERENCE WITHOUT CHANGING THEIR JOINT DISTRIBUTION.
+# FACTOR STATES ARE IN .fg ORDER:  THE FIRST LISTED VARIABLE CHANGES FASTEST
+
+from pgm import Factor
+
+
+def new_compaction_counts():
+    ''' factors_in / factors_out, vars_in / vars_out:  SIZE OF THE GRAPH BEFORE AND AFTER compact_factors
+        clamped:   VARIABLES CONDITIONED AWAY
+        constant:  FACTORS DROPPED BECAUSE THEIR WEIGHT DOES NOT DEPEND ON ANY (REMAINING) STATE
+        merged:    FACTORS MULTIPLIED INTO AN EARLIER FACTOR OVER THE SAME VARIABLES
+        factors_in == factors_out + constant + merged
+        '''
+    return {'factors_in': 0, 'factors_out': 0, 'vars_in': 0, 'vars_out': 0,
+            'clamped': 0, 'constant': 0, 'merged': 0}
+
+
+def add_compaction_counts(total, counts):
+    for (k, n) in counts.iteritems():
+        total[k] = total.get(k, 0) + n
+
+
+def get_states_of_vars(vars, li):
+    states = []
+    for v in vars:
+        states.append(li % v.nstates)
+        li //= v.nstates
+    return states
+
+
+def get_linear_index(vars, states):
+    li = 0
+    stride = 1
+    for (v, state) in zip(vars, states):
+        li += state * stride
+        stride *= v.nstates
+    return li
+
+
+def is_constant(values):
+    tolerance = 1e-12 * max(max(abs(x) for x in values), 1.0)
+    return all(abs(x - values[0]) <= tolerance for x in values)
+
+
+def find_clamped_state(factor):
+    ''' returns: THE ONLY STATE WITH NON-ZERO WEIGHT OF A UNARY FACTOR, OR None
+        '''
+    if len(factor.vars) != 1:
+        return None
+    nonzero = [state for (state, value) in enumerate(factor.states) if value != 0]
+    return nonzero[0] if len(nonzero) == 1 else None
+
+
+def get_states_over(factor, vars, id2fixed_state):
+    ''' input: vars  EVERY VARIABLE OF factor THAT IS NOT IN id2fixed_state, EACH LISTED ONCE
+        returns: states of factor over vars, with the other variables in their fixed state
+        '''
+    nr_states = 1
+    for v in vars:
+        nr_states *= v.nstates
+    states = []
+    for li in range(nr_states):
+        id2state = dict(id2fixed_state)
+        id2state.update((v.id, state) for (v, state) in zip(vars, get_states_of_vars(vars, li)))
+        states.append(factor.states[get_linear_index(factor.vars, [id2state[v.id] for v in factor.vars])])
+    return states
+
+
+def restrict_factor(factor, id2clamped_state):
+    ''' CONDITION factor ON THE CLAMPED VARIABLES AND LIST EACH VARIABLE ONCE
+        (A SELF-LOOP, A VARIABLE LISTED TWICE, KEEPS THE STATES WHERE BOTH COPIES AGREE)
+        returns: Factor over the remaining variables, None WHEN NONE REMAINS
+        '''
+    vars = []
+    for v in factor.vars:
+        if (v.id not in id2clamped_state) and (v not in vars):
+            vars.append(v)
+    if len(vars) == len(factor.vars):
+        return factor
+    if not vars:
+        return None
+    fixed = dict((v.id, id2clamped_state[v.id]) for v in factor.vars if v.id in id2clamped_state)
+    return Factor(vars=vars, states=get_states_over(factor, vars, fixed), comment=factor.comment)
+
+
+def compact_factors(factors, counts=None):
+    ''' 1. A UNARY FACTOR WITH A SINGLE NON-ZERO STATE CLAMPS ITS VARIABLE.  EVERY FACTOR IS CONDITIONED
+           ON IT, SO A proba=0.0 PRIOR AND THE IMPLICATIONS FROM ITS VARIABLE DISAPPEAR.  SELF-LOOPS ARE
+           REDUCED TO THEIR DIAGONAL
+        2. FACTORS OVER THE SAME VARIABLES (eg: p1 -> p2 AND p2 -> p1, OR ONE CONSTRAINT SEEN TWICE)
+           ARE MULTIPLIED INTO ONE
+        3. FACTORS WHOSE WEIGHT NO LONGER DEPENDS ON ANY STATE ARE DROPPED
+        input: list of Factor, dict of counts updated in place (see new_compaction_counts)
+        returns: tuple (compacted factors, {var: marginal} FOR THE VARIABLES THAT LEFT THE GRAPH)
+        '''
+    vars_in = set()
+    for factor in factors:
+        vars_in.update(factor.vars)
+    nr_factors_in = len(factors)
+
+    # 1. CLAMP, AGAIN WHILE CONDITIONING CREATES NEW CLAMPS.  CONFLICTING CLAMPS ARE LEFT TO INFERENCE
+    id2clamped_state = {}
+    while True:
+        id2new_state = {}
+        conflicting_ids = set()
+        for factor in factors:
+            state = find_clamped_state(factor)
+            if (state is not None) and (id2new_state.setdefault(factor.vars[0].id, state) != state):
+                conflicting_ids.add(factor.vars[0].id)
+        for i in conflicting_ids:
+            del id2new_state[i]
+        if not id2new_state:
+            break
+        id2clamped_state.update(id2new_state)
+        factors = [f for f in (restrict_factor(factor, id2clamped_state) for factor in factors) if f is not None]
+    factors = [restrict_factor(factor, {}) for factor in factors]
+    nr_conditioned_away = nr_factors_in - len(factors)
+
+    # 2. MERGE, AT THE POSITION OF THE FIRST FACTOR OVER THE SAME VARIABLES
+    ids2index = {}
+    merged_factors = []
+    for factor in factors:
+        ids = frozenset(v.id for v in factor.vars)
+        if ids not in ids2index:
+            ids2index[ids] = len(merged_factors)
+            merged_factors.append(factor)
+            continue
+        first = merged_factors[ids2index[ids]]
+        states = [a * b for (a, b) in zip(first.states, get_states_over(factor, first.vars, {}))]
+        top = max(states)
+        if top <= 0:
+            # CONTRADICTING FACTORS, KEEP BOTH AND LET INFERENCE SEE THEM AS BEFORE
+            merged_factors.append(factor)
+            continue
+        # RESCALE SO MANY MERGED COPIES DO NOT UNDERFLOW, THE DISTRIBUTION IS UNCHANGED
+        states = [s / top for s in states]
+        comment = first.comment
+        if factor.comment not in comment.split(' & '):
+            comment += ' & ' + factor.comment
+        merged_factors[ids2index[ids]] = Factor(vars=first.vars, states=states, comment=comment)
+
+    # 3. DROP CONSTANT FACTORS (AN ALL-ZERO FACTOR IS A CONTRADICTION, KEPT)
+    factors = [factor for factor in merged_factors if (not is_constant(factor.states)) or (not any(factor.states))]
+
+    vars_out = set()
+    for factor in factors:
+        vars_out.update(factor.vars)
+    var2marginal = {}
+    for v in vars_in - vars_out:
+        if v.id in id2clamped_state:
+            var2marginal[v] = tuple((1.0 if s == id2clamped_state[v.id] else 0.0) for s in range(v.nstates))
+        else:
+            var2marginal[v] = tuple((1.0 / v.nstates) for s in range(v.nstates))
+
+    if counts is not None:
+        add_compaction_counts(counts, {'factors_in': nr_factors_in,
+                                       'factors_out': len(factors),
+                                       'vars_in': len(vars_in),
+                                       'vars_out': len(vars_out),
+                                       'clamped': len(id2clamped_state),
+                                       'constant': nr_conditioned_away + len(merged_factors) - len(factors),
+                                       'merged': nr_factors_in - nr_conditioned_away - len(merged_factors)})
+    return (factors, var2marginal)
@@ -0,0 +1,243 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+
+# INFERENCE HELPERS THAT WORK ON ONE CONNECTED COMPONENT OF A FactorGraph AT A TIME.
+# FACTOR STATES ARE IN .fg ORDER:  THE FIRST LISTED VARIABLE CHANGES FASTEST
+
+
+def split_into_components(factors):
+    ''' UNION-FIND OVER THE VARIABLES OF THE FACTORS
+        input: list of Factor
+        returns: list of factor lists, one per connected component, in order of first appearance
+        '''
+    parent = {}
+
+    def find(x):
+        while parent[x] != x:
+            parent[x] = parent[parent[x]]
+            x = parent[x]
+        return x
+
+    for factor in factors:
+        ids = [v.id for v in factor.vars]
+        for i in ids:
+            parent.setdefault(i, i)
+        root = find(ids[0])
+        for i in ids[1:]:
+            r = find(i)
+            if r != root:
+                parent[r] = root
+
+    root2component = {}
+    components = []
+    for factor in factors:
+        root = find(factor.vars[0].id)
+        if root not in root2component:
+            root2component[root] = []
+            components.append(root2component[root])
+        root2component[root].append(factor)
+    return components
+
+
+def get_component_vars(factors):
+    vars = []
+    seen = set()
+    for factor in factors:
+        for v in factor.vars:
+            if v.id not in seen:
+                seen.add(v.id)
+                vars.append(v)
+    return vars
+
+
+def is_tree(factors):
+    ''' A CONNECTED FACTOR GRAPH IS A TREE IFF  #EDGES == #VARIABLES + #FACTORS - 1
+        (A FACTOR THAT LISTS THE SAME VARIABLE TWICE IS NEVER TREATED AS A TREE)
+        '''
+    nr_edges = 0
+    for factor in factors:
+        ids = set(v.id for v in factor.vars)
+        if len(ids) != len(factor.vars):
+            return False
+        nr_edges += len(ids)
+    return nr_edges == len(get_component_vars(factors)) + len(factors) - 1
+
+
+def get_states_of(factor, li):
+    ''' returns: state of every listed variable of factor at linear index li
+        '''
+    states = []
+    for v in factor.vars:
+        states.append(li % v.nstates)
+        li //= v.nstates
+    return states
+
+
+def solve_if_evidence_free(factors):
+    ''' A UNARY FACTOR THAT GIVES ALL ITS WEIGHT TO STATE 0 CLAMPS ITS (BINARY) VARIABLE.
+        IF, ONCE CONDITIONED ON THE CLAMPED VARIABLES, THE PRODUCT OF THE FACTORS OVER EACH SET
+        OF VARIABLES IS UNCHANGED BY FLIPPING ALL OF THEM, THE JOINT IS FLIP INVARIANT AND EVERY
+        FREE VARIABLE HAS MARGINAL (0.5, 0.5).  NO INFERENCE IS NEEDED
+        input: factors of one component
+        returns: {var: (p0, p1)}, or None if the component has evidence
+        '''
+    vars = get_component_vars(factors)
+    if any(v.nstates != 2 for v in vars):
+        return None
+
+    clamped = set()
+    for factor in factors:
+        if len(factor.vars) == 1 and factor.states[1] == 0 and factor.states[0] > 0:
+            clamped.add(factor.vars[0].id)
+
+    # CONDITION ON THE CLAMPED VARIABLES, MULTIPLY FACTORS THAT SPAN THE SAME FREE VARIABLES
+    ids2table = {}
+    for factor in factors:
+        free_ids = sorted(set(v.id for v in factor.vars if v.id not in clamped))
+        if not free_ids:
+            continue
+        table = ids2table.setdefault(tuple(free_ids), {})
+        for li, value in enumerate(factor.states):
+            assignment = {}
+            is_consistent = True
+            for (v, state) in zip(factor.vars, get_states_of(factor, li)):
+                if v.id in clamped:
+                    if state != 0:
+                        is_consistent = False
+                elif assignment.setdefault(v.id, state) != state:
+                    is_consistent = False
+            if not is_consistent:
+                continue
+            key = tuple(assignment[i] for i in free_ids)
+            table[key] = table.get(key, 1.0) * value
+
+    for table in ids2table.values():
+        for (key, value) in table.items():
+            flipped = table.get(tuple(1 - s for s in key), 0.0)
+            if abs(value - flipped) > 1e-12 * max(abs(value), abs(flipped), 1.0):
+                return None
+
+    return {v: ((1.0, 0.0) if v.id in clamped else (0.5, 0.5)) for v in vars}
+
+
+def solve_tree(factors):
+    ''' EXACT SUM-PRODUCT ON A TREE:  ONE COLLECT AND ONE DISTRIBUTE PASS OVER A BFS ORDER
+        input: factors of one component, is_tree(factors) must hold
+        returns: {var: tuple of normalized marginal probabilities}
+        '''
+    vars = get_component_vars(factors)
+    id2var = {v.id: v for v in vars}
+    var2factors = {v.id: [] for v in vars}
+    for fi, factor in enumerate(factors):
+        for v in factor.vars:
+            var2factors[v.id].append(fi)
+
+    # NODES ARE ('v', var id) AND ('f', factor index)
+    def neighbours_of(node):
+        if node[0] == 'v':
+            return [('f', fi) for fi in var2factors[node[1]]]
+        return [('v', v.id) for v in factors[node[1]].vars]
+
+    root = ('v', vars[0].id)
+    parent = {root: None}
+    order = [root]
+    i = 0
+    while i < len(order):
+        node = order[i]
+        i += 1
+        for n in neighbours_of(node):
+            if n != parent[node]:
+                parent[n] = node
+                order.append(n)
+
+    messages = {}
+
+    def send(source, target):
+        if source[0] == 'v':
+            msg = [1.0] * id2var[source[1]].nstates
+            for n in neighbours_of(source):
+                if n != target:
+                    incoming = messages[(n, source)]
+                    msg = [a * b for (a, b) in zip(msg, incoming)]
+        else:
+            factor = factors[source[1]]
+            target_pos = [v.id for v in factor.vars].index(target[1])
+            msg = [0.0] * factor.vars[target_pos].nstates
+            for li, value in enumerate(factor.states):
+                states = get_states_of(factor, li)
+                for (pos, v) in enumerate(factor.vars):
+                    if pos != target_pos:
+                        value *= messages[(('v', v.id), source)][states[pos]]
+                msg[states[target_pos]] += value
+        total = sum(msg)
+        if total > 0:
+            msg = [m / total for m in msg]
+        messages[(source, target)] = msg
+
+    # COLLECT:  LEAVES TO ROOT
+    for node in reversed(order):
+        if parent[node] is not None:
+            send(node, parent[node])
+    # DISTRIBUTE:  ROOT TO LEAVES
+    for node in order:
+        for n in neighbours_of(node):
+            if parent.get(n) == node:
+                send(node, n)
+
+    marginals = {}
+    for v in vars:
+        belief = [1.0] * v.nstates
+        for fi in var2factors[v.id]:
+            belief = [a * b for (a, b) in zip(belief, messages[(('f', fi), ('v', v.id))])]
+        total = sum(belief)
+        if total > 0:
+            marginals[v] = tuple(b / total for b in belief)
+        else:
+            # INCONSISTENT EVIDENCE, NOTHING TO SAY (AS edge_bp.normalize)
+            marginals[v] = tuple(1.0 / v.nstates for b in belief)
+    return marginals
+
+
+class ComponentMemo(object):
+    ''' MARGINALS OF SOLVED COMPONENTS, KEPT FROM ONE SOLVE ROUND TO THE NEXT.
+        A COMPONENT IS KEYED BY ITS SIGNATURE:  THE SORTED (STABLE VARIABLE KEYS, STATES) OF ITS FACTORS,
+        SO THE KEY DOES NOT DEPEND ON THE pgm.Variable IDS OR THE FACTOR ORDER OF A ROUND.
+        ONLY THE PREVIOUS ROUND IS KEPT.
+        ALSO THE LATEST FINAL BP MESSAGE OF EVERY EDGE SOLVED BY EdgeBPEngine, KEYED BY EDGE
+        (EdgeBPEngine.get_messages), TO WARM START A CHANGED COMPONENT IN A LATER ROUND
+        (PGMPlayer.should_warm_start_edge_bp)
+        '''
+
+    def __init__(self):
+        self.previous = {}
+        self.current = {}
+        self.messages = {}
+        self.nr_hits = 0
+        self.nr_misses = 0
+
+    def start_round(self):
+        self.previous = self.current
+        self.current = {}
+
+    def lookup(self, signature):
+        ''' returns: {stable key: p0} of the component, or None
+            '''
+        key2p0 = self.current.get(signature)
+        if key2p0 is None:
+            key2p0 = self.previous.get(signature)
+        if key2p0 is None:
+            self.nr_misses += 1
+        else:
+            self.nr_hits += 1
+        return key2p0
+
+    def store(self, signature, key2p0):
+        self.current[signature] = key2p0
+
+    def store_messages(self, edge_key2msg):
+        self.messages.update(edge_key2msg)
+
+
+def get_component_signature(factors, get_stable_key):
+    return tuple(sorted((tuple(get_stable_key(v) for v in factor.vars), tuple(factor.states))
+                        for factor in factors))
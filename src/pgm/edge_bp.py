@@ -0,0 +1,267 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+
+# LOOPY BELIEF PROPAGATION FOR GRAPHS OF BINARY VARIABLES WITH UNARY AND PAIRWISE FACTORS ONLY,
+# WHICH IS EVERYTHING THE ConstraintSolver EMITS (PRIORS states=[0, 1], IMPLICATIONS states=[1, 0, 1, 1]).
+# THE GRAPH IS HELD AS FLAT EDGE ARRAYS, EVERY MESSAGE IS ONE FLOAT (ITS PROBABILITY OF STATE 0),
+# SO NEITHER libDAI NOR ITS SWIG BINDINGS ARE NEEDED
+
+import heapq
+import re
+import sys
+from os.path import join, dirname
+
+
+ALIAS_PATTERN = re.compile(r'^\s*([^#:\s]+)\s*:\s*(\w+)\[(.*)\]\s*$')
+
+filename2aliases = {}
+
+
+def read_aliases(filename):
+    ''' THE SAME aliases.conf AS libDAI, eg:  BP:  BP[updates=SEQMAX,tol=1e-9,maxiter=10000]
+        returns: {alias: (algorithm name, {property: value})}
+        '''
+    if filename not in filename2aliases:
+        aliases = {}
+        with open(filename) as f:
+            for line in f:
+                m = ALIAS_PATTERN.match(line)
+                if m:
+                    props = dict(kv.split('=', 1) for kv in m.group(3).split(',') if '=' in kv)
+                    aliases[m.group(1)] = (m.group(2), props)
+        filename2aliases[filename] = aliases
+    return filename2aliases[filename]
+
+
+class EdgeBPEngine(object):
+    ''' SAME INTERFACE AS PGMEngine.  DIRECTED EDGE d AND d ^ 1 ARE THE TWO DIRECTIONS OF ONE PAIRWISE FACTOR.
+        UPDATE SCHEDULES (THE 'updates' PROPERTY OF THE METHOD):
+            SEQMAX  RESIDUAL BP, ALWAYS SEND THE MESSAGE THAT CHANGES MOST
+            PARALL  FLOODING, ALL MESSAGES FROM THE PREVIOUS ITERATION AT ONCE
+        '''
+
+    def __init__(self, factor_graph):
+        self.factor_graph = factor_graph
+        self.method = ''
+        self.updates = 'SEQMAX'
+        self.tol = 1e-9
+        self.maxiter = 10000
+        self.var2index = {}
+        # PER VARIABLE:  PRODUCT OF ITS UNARY FACTORS
+        self.prior0 = []
+        self.prior1 = []
+        # PER DIRECTED EDGE:  SOURCE, TARGET, INDEX IN self.tables, MESSAGE
+        self.edge_src = []
+        self.edge_dst = []
+        self.edge_table = []
+        self.msg = []
+        # PER VARIABLE:  DIRECTED EDGES INTO IT
+        self.incoming = []
+        # DISTINCT ORIENTED TABLES (w00, w01, w10, w11), w<source state><target state>
+        self.tables = []
+        self.nr_updates = 0
+        # SET BY run():  False WHEN maxiter WAS REACHED FIRST, maxdiff IS THEN THE LARGEST PENDING CHANGE
+        self.converged = True
+        self.maxdiff = 0.0
+        # PER DIRECTED EDGE:  MESSAGE TO START FROM (None:  UNIFORM), SEE seed_messages
+        self.initial_msg = None
+
+    @staticmethod
+    def supports(factors):
+        ''' returns: True IF EVERY FACTOR IS UNARY OR PAIRWISE OVER BINARY VARIABLES
+            '''
+        for factor in factors:
+            if len(factor.vars) > 2:
+                return False
+            if any(v.nstates != 2 for v in factor.vars):
+                return False
+        return True
+
+    def prepare(self, method, fg_filename=None):
+        ''' input: method  inference method name (see aliases.conf), only sum-product BP variants are supported
+                   fg_filename  optional, also write the graph to this .fg file (debugging only)
+            '''
+        if fg_filename:
+            self.factor_graph.dump(fg_filename)
+        (name, props) = read_aliases(join(dirname(__file__), 'aliases.conf')).get(method, (method, {}))
+        if name != 'BP' or props.get('logdomain', '0') != '0' or float(props.get('damping', '0')) != 0.0:
+            raise ValueError('EdgeBPEngine does not support method %s' % method)
+        # MESSAGES ARE ONLY EVER SUM-PRODUCT:  A MAXPROD ALIAS (MP_*) MUST NOT SILENTLY RUN SUM-PRODUCT
+        if props.get('inference', 'SUMPROD') != 'SUMPROD':
+            raise ValueError('EdgeBPEngine does not support inference=%s' % props['inference'])
+        self.method = method
+        self.updates = props.get('updates', 'SEQMAX')
+        if self.updates not in ('SEQMAX', 'PARALL'):
+            raise ValueError('EdgeBPEngine does not support updates=%s' % self.updates)
+        self.tol = float(props.get('tol', self.tol))
+        self.maxiter = int(props.get('maxiter', self.maxiter))
+        self._build_edge_arrays()
+
+    def _build_edge_arrays(self):
+        vars = sorted(self.factor_graph.vars, key=lambda v: v.id)
+        self.index2var = vars
+        self.var2index = {v: i for (i, v) in enumerate(vars)}
+        self.prior0 = [1.0] * len(vars)
+        self.prior1 = [1.0] * len(vars)
+        self.incoming = [[] for v in vars]
+        table2index = {}
+
+        def add_edge(src, dst, table):
+            if table not in table2index:
+                table2index[table] = len(self.tables)
+                self.tables.append(table)
+            self.incoming[dst].append(len(self.edge_src))
+            self.edge_src.append(src)
+            self.edge_dst.append(dst)
+            self.edge_table.append(table2index[table])
+            self.msg.append(0.5)
+
+        for factor in self.factor_graph.factors:
+            s = factor.states
+            if len(factor.vars) == 1:
+                i = self.var2index[factor.vars[0]]
+                self.prior0[i] *= s[0]
+                self.prior1[i] *= s[1]
+                continue
+            (a, b) = [self.var2index[v] for v in factor.vars]
+            if a == b:
+                # ONLY THE DIAGONAL IS CONSISTENT
+                self.prior0[a] *= s[0]
+                self.prior1[a] *= s[3]
+                continue
+            # .fg ORDER:  s[sa + 2 * sb]
+            add_edge(a, b, (s[0], s[2], s[1], s[3]))
+            add_edge(b, a, (s[0], s[1], s[2], s[3]))
+
+    def _compute_outgoing(self, i, skip=None):
+        ''' NEW MESSAGES ON EVERY DIRECTED EDGE OUT OF VARIABLE i, EXCEPT THE REVERSE OF skip
+            returns: list of (directed edge, probability of state 0)
+            '''
+        incoming = self.incoming[i]
+        k = len(incoming)
+        # NORMALIZED PREFIX AND SUFFIX PRODUCTS OF THE INCOMING MESSAGES (NO UNDERFLOW ON HUBS)
+        pre = [(1.0, 1.0)] * (k + 1)
+        for j in range(k):
+            m = self.msg[incoming[j]]
+            pre[j + 1] = normalize(pre[j][0] * m, pre[j][1] * (1.0 - m))
+        suf = [(1.0, 1.0)] * (k + 1)
+        for j in range(k - 1, -1, -1):
+            m = self.msg[incoming[j]]
+            suf[j] = normalize(suf[j + 1][0] * m, suf[j + 1][1] * (1.0 - m))
+
+        p0 = self.prior0[i]
+        p1 = self.prior1[i]
+        result = []
+        for j in range(k):
+            if incoming[j] == skip:
+                continue
+            (c0, c1) = normalize(p0 * pre[j][0] * suf[j + 1][0], p1 * pre[j][1] * suf[j + 1][1])
+            out = incoming[j] ^ 1
+            (w00, w01, w10, w11) = self.tables[self.edge_table[out]]
+            result.append((out, normalize(w00 * c0 + w10 * c1, w01 * c0 + w11 * c1)[0]))
+        return result
+
+    def get_edge_key(self, d, get_stable_key):
+        return (get_stable_key(self.index2var[self.edge_src[d]]),
+                get_stable_key(self.index2var[self.edge_dst[d]]),
+                self.tables[self.edge_table[d]])
+
+    def get_messages(self, get_stable_key):
+        ''' returns: {(stable key of source, stable key of target, table): message} OF EVERY DIRECTED EDGE
+            '''
+        return {self.get_edge_key(d, get_stable_key): m for (d, m) in enumerate(self.msg)}
+
+    def seed_messages(self, edge_key2msg, get_stable_key):
+        ''' WARM START:  THE NEXT run() STARTS EVERY EDGE FOUND IN edge_key2msg (SAME VARIABLES, SAME TABLE,
+            eg: FROM get_messages OF AN EARLIER GRAPH) FROM THAT MESSAGE INSTEAD OF UNIFORM.  CALL AFTER prepare()
+            returns: number of seeded edges
+            '''
+        self.initial_msg = [0.5] * len(self.edge_src)
+        nr_seeded = 0
+        for d in xrange(len(self.edge_src)):
+            m = edge_key2msg.get(self.get_edge_key(d, get_stable_key))
+            if m is not None:
+                self.initial_msg[d] = m
+                nr_seeded += 1
+        return nr_seeded
+
+    def run(self):
+        self.msg = list(self.initial_msg) if self.initial_msg else [0.5] * len(self.edge_src)
+        self.nr_updates = 0
+        if self.updates == 'PARALL':
+            self._run_flooding()
+        else:
+            self._run_residual()
+        if not self.converged:
+            # AS libDAI's BP::run REPORTS IT
+            sys.stderr.write('EdgeBPEngine::run:  WARNING: not converged after %d message updates (%s), '
+                             'final maxdiff: %g\n' % (self.nr_updates, self.method, self.maxdiff))
+
+    def _run_flooding(self):
+        self.converged = False
+        for iteration in xrange(self.maxiter):
+            new_msg = list(self.msg)
+            for i in xrange(len(self.incoming)):
+                for (d, m) in self._compute_outgoing(i):
+                    new_msg[d] = m
+            self.maxdiff = max([abs(a - b) for (a, b) in zip(new_msg, self.msg)] or [0.0])
+            self.msg = new_msg
+            self.nr_updates += len(new_msg)
+            if self.maxdiff < self.tol:
+                self.converged = True
+                break
+
+    def _run_residual(self):
+        candidate = list(self.msg)
+        heap = []
+
+        def push(updates):
+            for (d, m) in updates:
+                candidate[d] = m
+                residual = abs(m - self.msg[d])
+                if residual >= self.tol:
+                    heapq.heappush(heap, (-residual, d, m))
+
+        for i in xrange(len(self.incoming)):
+            push(self._compute_outgoing(i))
+
+        max_updates = self.maxiter * max(len(self.msg), 1)
+        while heap and self.nr_updates < max_updates:
+            (neg_residual, d, m) = heapq.heappop(heap)
+            if m != candidate[d] or self.msg[d] == m:
+                # STALE ENTRY, A NEWER CANDIDATE FOR d WAS PUSHED (OR ALREADY SENT)
+                continue
+            self.msg[d] = m
+            self.nr_updates += 1
+            push(self._compute_outgoing(self.edge_dst[d], skip=d))
+
+        pending = [abs(candidate[d] - self.msg[d]) for (neg_residual, d, m) in heap if m == candidate[d]]
+        self.maxdiff = max(pending or [0.0])
+        self.converged = (self.maxdiff < self.tol)
+
+    @property
+    def vars(self):
+        return self.factor_graph.vars
+
+    @property
+    def factors(self):
+        return self.factor_graph.factors
+
+    def query_var_marginal(self, var):
+        i = self.var2index[var]
+        (b0, b1) = (self.prior0[i], self.prior1[i])
+        for d in self.incoming[i]:
+            (b0, b1) = normalize(b0 * self.msg[d], b1 * (1.0 - self.msg[d]))
+        return normalize(b0, b1)
+
+    def query_all_var_marginals(self):
+        return {var: self.query_var_marginal(var)
+                for var in self.factor_graph.vars}
+
+
+def normalize(x0, x1):
+    total = x0 + x1
+    if total > 0:
+        return (x0 / total, x1 / total)
+    # INCONSISTENT EVIDENCE, NOTHING TO SAY
+    return (0.5, 0.5)
@@ -4,34 +4,27 @@
 
 from os.path import join, dirname
 from StringIO import StringIO
-import dai
+try:
+    import dai
+except ImportError:
+    # THE SWIG BINDINGS NEED _dai.so (LD_LIBRARY_PATH), EdgeBPEngine WORKS WITHOUT THEM
+    dai = None
 
 
-class Variable(object):
+def is_dai_available():
+    return dai is not None
+
 
-    name2id = {}
-    count = 0
+class Variable(object):
+    ''' id_ IS GIVEN BY THE OWNER OF THE GRAPH (PGMPlayer NUMBERS ITS OWN VARIABLES),
+        SO GRAPHS BUILT SIDE BY SIDE NEVER SHARE A COUNTER
+        '''
 
-    def __init__(self, name, id_=None, nstates=2):
-        self.id = self.get_id(name) if id_ is None else id_
+    def __init__(self, name, id_, nstates=2):
+        self.id = id_
         self.name = name
         self.nstates = nstates
 
-    @classmethod
-    def get_id(cls, name):
-        try:
-            return cls.name2id[name]
-        except KeyError:
-            id_ = cls.count
-            cls.name2id[name] = id_
-            cls.count += 1
-        return id_
-
-    @classmethod
-    def reset(cls):
-        cls.name2id.clear()
-        cls.count = 0
-
     def __str__(self):
         return 'x%d: %s(%d)' % (self.id, self.name, self.nstates)
 
@@ -99,8 +92,60 @@ class FactorGraph(object):
             buf.write('\n\n')
         return buf.getvalue()
 
+    def to_dai(self):
+        ''' BUILD THE libDAI FACTOR GRAPH IN MEMORY, SAME RESULT AS dump() FOLLOWED BY ReadFromFile()
+            returns: dai.FactorGraph
+            '''
+        id2dai_var = {}
+        dai_factors = dai.VecFactor()
+        for factor in self.factors:
+            var_set = dai.VarSet()
+            for v in factor.vars:
+                if v.id not in id2dai_var:
+                    id2dai_var[v.id] = dai.Var(v.id, v.nstates)
+                var_set.append(id2dai_var[v.id])
+            dai_factor = dai.Factor(var_set)
+            permutation = get_linear_index_permutation([v.id for v in factor.vars],
+                                                       [v.nstates for v in factor.vars])
+            for i, s in enumerate(factor.states):
+                dai_factor.set(permutation[i], s)
+            dai_factors.append(dai_factor)
+        return dai.FactorGraph(dai_factors)
+
+
+order2permutation = {}
+
+
+def get_linear_index_permutation(labels, nstates):
+    ''' .fg FILES LIST THE STATES OF A FACTOR WITH ITS FIRST LISTED VARIABLE CHANGING FASTEST,
+        libDAI STORES THEM WITH THE VARIABLE OF LOWEST LABEL CHANGING FASTEST
+        input: labels and number of states of the factor variables, in listed order
+        returns: list mapping a listed-order linear index to the libDAI linear index
+        '''
+    order = tuple(sorted(range(len(labels)), key=lambda k: labels[k]))
+    key = (order, tuple(nstates))
+    if key not in order2permutation:
+        # STRIDE OF EACH LISTED VARIABLE IN LABEL ORDER
+        strides = [0] * len(labels)
+        stride = 1
+        for k in order:
+            strides[k] = stride
+            stride *= nstates[k]
+        permutation = []
+        for li in range(stride):
+            rest = li
+            index = 0
+            for k in range(len(labels)):
+                index += (rest % nstates[k]) * strides[k]
+                rest //= nstates[k]
+            permutation.append(index)
+        order2permutation[key] = permutation
+    return order2permutation[key]
+
 
 class PGMEngine(object):
+    filename2aliases = {}
+
     def __init__(self, factor_graph):
         self.factor_graph = factor_graph
         self.method_aliases = None
@@ -109,19 +154,31 @@ class PGMEngine(object):
         self.method = ''
         self.dai_factor_graph = None
         self.inference = None
-
-    def prepare(self, fg_filename, method):
+        self.var2index = {}
+
+    def prepare(self, method, fg_filename=None):
+        ''' input: method  inference method name (see aliases.conf)
+                   fg_filename  optional, also write the graph to this .fg file (debugging only,
+                                inference never reads it)
+            '''
+        if dai is None:
+            raise ImportError('libDAI python bindings (_dai) not found')
         self._prepare_dai_factor_graph(fg_filename)
+        # libDAI INDEXES VARIABLES IN LABEL ORDER
+        self.var2index = {v: i for (i, v) in enumerate(sorted(self.factor_graph.vars, key=lambda v: v.id))}
         self._prepare_method_aliases(join(dirname(__file__), 'aliases.conf'))
         self.load_inference(method)
 
-    def _prepare_dai_factor_graph(self, filename):
-        self.factor_graph.dump(filename)
-        self.dai_factor_graph = dai.FactorGraph()
-        self.dai_factor_graph.ReadFromFile(filename)
+    def _prepare_dai_factor_graph(self, filename=None):
+        if filename:
+            self.factor_graph.dump(filename)
+        self.dai_factor_graph = self.factor_graph.to_dai()
 
     def _prepare_method_aliases(self, filename):
-        self.method_aliases = dai.readAliasesFile(filename)
+        # THE ALIASES FILE NEVER CHANGES DURING A RUN, PARSE IT ONCE PER PROCESS
+        if filename not in PGMEngine.filename2aliases:
+            PGMEngine.filename2aliases[filename] = dai.readAliasesFile(filename)
+        self.method_aliases = PGMEngine.filename2aliases[filename]
 
     def load_inference(self, method):
         if method in self.method2inference:
@@ -149,9 +206,8 @@ class PGMEngine(object):
         return self.factor_graph.factors
 
     def query_var_marginal(self, var):
-        # after test, we find the id is exactly equal to the index
-        # TODO: may refactor it in the future
-        factor = self.inference.beliefV(var.id)
+        # THE INDEX EQUALS THE id ONLY WHEN THE LABELS ARE 0..n-1, WHICH IS NOT THE CASE FOR A COMPONENT
+        factor = self.inference.beliefV(self.var2index[var])
         return factor[0], factor[1]
 
     def query_all_var_marginals(self):
@@ -1,16 +1,41 @@
 #!/usr/bin/env python
 # -*- coding: utf-8 -*-
 
-from pgm import Variable, Factor, FactorGraph, PGMEngine
+from pgm import Variable, Factor, FactorGraph, PGMEngine, is_dai_available
+from edge_bp import EdgeBPEngine
+from components import split_into_components, is_tree, solve_tree, solve_if_evidence_free
+from components import get_component_vars, get_component_signature
+from compaction import compact_factors, new_compaction_counts
+
+
+# INFERENCE BACKEND FOR COMPONENTS THAT ARE NOT SOLVED EXACTLY:
+#   'libdai'  PGMEngine, THE SWIG libDAI BINDINGS
+#   'edge'    EdgeBPEngine, PURE PYTHON, UNARY AND PAIRWISE BINARY FACTORS (OTHER GRAPHS GO TO libDAI).
+#             EXPERIMENTAL, OPT-IN (PGMPlayer.bp_backend, ConstraintSolver.bp_backend).  bench_edge_bp.py
+#             COMPARES ITS TIME AND MARGINALS WITH libDAI ON FILES OF data/
+DEFAULT_BP_BACKEND = 'libdai'
 
 
 class PGMPlayer(object):
 
-    def __init__(self, fg_filename='test.fg'):
+    def __init__(self, fg_filename=None):
         self.fg_filename = fg_filename
         self.curr_factors = []
         self.strvar2pgmvar = {}
-        Variable.reset()
+        # SOLVE EACH CONNECTED COMPONENT ON ITS OWN (SKIP / EXACT / libDAI)
+        self.should_split_components = True
+        self.component_counts = {'evidence_free': 0, 'tree': 0, 'loopy': 0, 'reused': 0,
+                                 'edge_bp_warm_started': 0}
+        # CONDITION ON CLAMPED VARIABLES, MERGE DUPLICATE FACTORS AND DROP CONSTANT ONES BEFORE INFERENCE
+        self.should_compact_factors = True
+        self.compaction_counts = new_compaction_counts()
+        # ComponentMemo SHARED ACROSS SOLVE ROUNDS:  UNCHANGED LOOPY COMPONENTS ARE NOT RE-RUN
+        self.component_memo = None
+        self.bp_backend = DEFAULT_BP_BACKEND
+        # START CHANGED LOOPY COMPONENTS FROM THE MESSAGES OF EARLIER ROUNDS IN component_memo (EdgeBPEngine ONLY).
+        # OPT-IN:  WHEN CONFLICTING EVIDENCE GIVES LOOPY BP SEVERAL FIXED POINTS, A WARM START CAN CONVERGE TO
+        # ANOTHER ONE THAN THE COLD START, THE RESULT WOULD THEN DEPEND ON THE EARLIER ROUNDS
+        self.should_warm_start_edge_bp = False
 
     def add_factor(self, left, right, states, proba, comment):
         left = [self.get_var(x) for x in left]
@@ -20,17 +45,85 @@ class PGMPlayer(object):
                         comment=comment)
         self.curr_factors.append(factor)
 
-    def _build_factor_graph(self):
+    def _build_factor_graph(self, factors):
         factor_graph = FactorGraph()
-        for c in self.curr_factors:
+        for c in factors:
             factor_graph.add_factor(c)
         return factor_graph
 
     def compute_marginals(self, alg='BP'):
-        factor_graph = self._build_factor_graph()
-        pgmengine = PGMEngine(factor_graph)
-        pgmengine.prepare(self.fg_filename, alg)
+        factors = self.curr_factors
+        pgmvar2proba = {}
+        if self.should_compact_factors:
+            (factors, removed_var2marginal) = compact_factors(factors, self.compaction_counts)
+            pgmvar2proba.update({pv: p[0] for pv, p in removed_var2marginal.iteritems()})
+
+        if not self.should_split_components:
+            if factors:
+                pgmvar2proba.update(self._run_inference(factors, alg, self.fg_filename))
+            return pgmvar2proba
+
+        for factors in split_into_components(factors):
+            marginals = solve_if_evidence_free(factors)
+            if marginals is not None:
+                self.component_counts['evidence_free'] += 1
+            elif is_tree(factors):
+                self.component_counts['tree'] += 1
+                marginals = solve_tree(factors)
+            else:
+                pgmvar2proba.update(self._solve_loopy_component(factors, alg))
+                continue
+            pgmvar2proba.update({pv: p[0] for pv, p in marginals.iteritems()})
+        return pgmvar2proba
+
+    def _solve_loopy_component(self, factors, alg):
+        ''' REUSE THE MARGINALS OF THE PREVIOUS ROUND WHEN THE COMPONENT IS UNCHANGED,
+            OTHERWISE RUN INFERENCE ON IT AND REMEMBER THE RESULT FOR THE NEXT ROUND
+            returns: {pgm var: p0}
+            '''
+        if self.component_memo is None:
+            self.component_counts['loopy'] += 1
+            return self._run_inference(factors, alg)
+
+        signature = get_component_signature(factors, self.get_stable_key)
+        key2p0 = self.component_memo.lookup(signature)
+        if key2p0 is None:
+            self.component_counts['loopy'] += 1
+            pgmvar2proba = self._run_inference(factors, alg)
+            key2p0 = {self.get_stable_key(pv): p0 for pv, p0 in pgmvar2proba.iteritems()}
+        else:
+            self.component_counts['reused'] += 1
+        self.component_memo.store(signature, key2p0)
+        return {pv: key2p0[self.get_stable_key(pv)] for pv in get_component_vars(factors)}
+
+    def get_stable_key(self, var):
+        ''' returns: A KEY OF var THAT DOES NOT CHANGE FROM ONE SOLVE ROUND TO THE NEXT
+            '''
+        return var.name
+
+    def _run_inference(self, factors, alg, fg_filename=None):
+        ''' returns: {pgm var: p0} FROM THE SELECTED BACKEND
+            '''
+        if self.bp_backend == 'edge' and EdgeBPEngine.supports(factors):
+            return self._compute_marginals_with_engine(EdgeBPEngine, factors, alg, fg_filename)
+        if not is_dai_available():
+            raise ImportError("libDAI python bindings (dai) not found, install them or set bp_backend = 'edge'")
+        return self._compute_marginals_with_engine(PGMEngine, factors, alg, fg_filename)
+
+    def _compute_marginals_with_engine(self, engine_class, factors, alg, fg_filename=None):
+        factor_graph = self._build_factor_graph(factors)
+        pgmengine = engine_class(factor_graph)
+        pgmengine.prepare(alg, fg_filename)
+        # THE SWIG libDAI BINDINGS CANNOT SET MESSAGES:  ONLY EdgeBPEngine (bp_backend = 'edge') IS WARM STARTED,
+        # A CHANGED COMPONENT SOLVED BY libDAI STARTS COLD
+        should_warm_start = (self.should_warm_start_edge_bp and (self.component_memo is not None)
+                             and (engine_class is EdgeBPEngine))
+        if should_warm_start:
+            if pgmengine.seed_messages(self.component_memo.messages, self.get_stable_key):
+                self.component_counts['edge_bp_warm_started'] += 1
         pgmengine.run()
+        if should_warm_start:
+            self.component_memo.store_messages(pgmengine.get_messages(self.get_stable_key))
         pgmvar2proba = pgmengine.query_all_var_marginals()
         return {pv: p0 for pv, (p0, _) in pgmvar2proba.iteritems()}
 
@@ -38,11 +131,69 @@ class PGMPlayer(object):
         try:
             var = self.strvar2pgmvar[vname]
         except KeyError:
-            var = Variable(vname, id_=None, nstates=2)
+            var = Variable(vname, id_=len(self.strvar2pgmvar), nstates=2)
             self.strvar2pgmvar[vname] = var
         return var
 
 
+class MultiUnitPGMPlayer(PGMPlayer):
+    ''' ONE INDEPENDENT COPY OF THE GRAPH PER CANDIDATE UNIT, ALL SOLVED BY ONE INFERENCE.
+        THE COPIES SHARE NO VARIABLE, SO THE JOINT GRAPH IS THEIR DISJOINT UNION AND
+        THE MARGINALS OF EACH COPY ARE THOSE OF THE GRAPH OF THAT UNIT ALONE.
+        THIS SAVES THE CONSTRAINT SCANS AND THE PLAYERS, NOT INFERENCE:  ITS COST IS STILL |units| TIMES THE
+        GRAPH OF ONE UNIT.  WITH should_split_components EVERY COPY IS SOLVED ON ITS OWN, WITHOUT IT ONE BP RUN
+        STOPS ON ONE TOLERANCE FOR ALL THE COPIES, SO A COPY MAY DIFFER FROM ITS OWN SOLVE WITHIN THAT TOLERANCE
+        '''
+
+    def __init__(self, nunits, fg_filename=None):
+        PGMPlayer.__init__(self, fg_filename)
+        self.nunits = nunits
+        self.copy_name2unit_and_name = {}
+        # SET BY THE OWNER TO KEY VARIABLES BY (variable.Id, name, unit), SEE get_stable_key
+        self.unit_keys = None
+        self.vname2identity = {}
+
+    def add_unit_factor(self, left, right, states, probas, comment):
+        ''' input: probas  one entry per unit, None WHEN THE FACTOR IS ABSENT FROM THE GRAPH OF THAT UNIT.
+                           A SINGLE NUMBER IS USED FOR EVERY UNIT
+            '''
+        if not isinstance(probas, list):
+            probas = [probas] * self.nunits
+        for unit_index, proba in enumerate(probas):
+            if proba is None:
+                continue
+            self.add_factor(left=[self.get_copy_name(unit_index, x) for x in left],
+                            right=[self.get_copy_name(unit_index, x) for x in right],
+                            states=states,
+                            proba=proba,
+                            comment=comment)
+
+    def get_copy_name(self, unit_index, vname):
+        copy_name = '%s@%d' % (vname, unit_index)
+        self.copy_name2unit_and_name[copy_name] = (unit_index, vname)
+        return copy_name
+
+    def get_stable_key(self, var):
+        ''' THE COPY NAME DEPENDS ON THE POSITION OF THE UNIT IN THIS ROUND, THE PREDICATE DOES NOT
+            returns: (unit key, vname identity)
+            '''
+        if self.unit_keys is None:
+            return var.name
+        (unit_index, vname) = self.copy_name2unit_and_name[var.name]
+        return (self.unit_keys[unit_index], self.vname2identity.get(vname, vname))
+
+    def compute_marginals_by_unit(self, alg='BP'):
+        ''' returns: list with one dict per unit, {vname: p0} FOR THE VARIABLES IN THE GRAPH OF THAT UNIT
+            '''
+        unit2vname2proba = [{} for i in range(self.nunits)]
+        if not self.curr_factors:
+            return unit2vname2proba
+        for pv, p0 in self.compute_marginals(alg).iteritems():
+            (unit_index, vname) = self.copy_name2unit_and_name[pv.name]
+            unit2vname2proba[unit_index][vname] = p0
+        return unit2vname2proba
+
+
 if __name__ == '__main__':
     
     player = PGMPlayer()
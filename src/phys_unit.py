@@ -0,0 +1,211 @@
+#!/usr/bin/env python
+
+
+# BASE DIMENSIONS, IN THE ORDER OF THE UNIT VECTORS READ BY SymbolHelper.convert_vector_units_to_dict
+BASE_DIMENSIONS = ('meter', 'second', 'radian', 'degree_360', 'quaternion',
+                   'kilogram', 'amp', 'degree_celsius', 'mol', 'candela')
+
+
+class PhysUnit(dict):
+    ''' IMMUTABLE, INTERNED PHYSICAL UNIT.  MAPS A BASE DIMENSION (OR A PSEUDO UNIT SUCH AS
+        'nounit', 'radian_unit', 'degree_360_unit', 'wrong') TO ITS EXPONENT, eg: {'meter': 1.0, 'second': -1.0}
+        THERE IS EXACTLY ONE INSTANCE PER DISTINCT UNIT, SO EQUALITY IS IDENTITY AND THE HASH IS PRECOMPUTED.
+        STILL A dict, SO COMPARISONS WITH PLAIN DICTS, str() AND json KEEP WORKING.
+        DO NOT INSTANTIATE DIRECTLY, USE make_unit()
+        '''
+    __slots__ = ('_hash',)
+
+    def __hash__(self):
+        return self._hash
+
+    def __eq__(self, other):
+        if self is other:
+            return True
+        if isinstance(other, PhysUnit):
+            # INTERNED:  TWO DISTINCT INSTANCES ARE NEVER EQUAL
+            return False
+        return dict.__eq__(self, other)
+
+    def __ne__(self, other):
+        if self is other:
+            return False
+        if isinstance(other, PhysUnit):
+            return True
+        return dict.__ne__(self, other)
+
+    def _raise_immutable(self, *args, **kwargs):
+        raise TypeError('PhysUnit is immutable')
+
+    __setitem__ = __delitem__ = clear = pop = popitem = setdefault = update = _raise_immutable
+
+    def __copy__(self):
+        return self
+
+    def __deepcopy__(self, memo):
+        return self
+
+    def __reduce__(self):
+        # RE-INTERN ON UNPICKLE
+        return (make_unit, (dict(self),))
+
+
+_key2unit = {}
+_str2unit = {}
+_product_cache = {}
+_quotient_cache = {}
+_scale_cache = {}
+
+
+def make_unit(mapping):
+    ''' input: dict of dimension -> exponent  (or a PhysUnit).  THE UNIT OF A NESTED ROS MESSAGE,
+               eg: MultiDOFJointState.wrench, MAPS ITS ATTRIBUTES TO UNITS, THOSE ARE INTERNED TOO
+        returns: the interned PhysUnit with the same exponents
+        '''
+    if isinstance(mapping, PhysUnit):
+        return mapping
+    items = [(k, make_unit(v) if isinstance(v, dict) else v) for (k, v) in mapping.iteritems()]
+    key = frozenset(items)
+    unit = _key2unit.get(key)
+    if unit is None:
+        unit = PhysUnit(items)
+        unit._hash = hash(key)
+        _key2unit[key] = unit
+    return unit
+
+
+def make_unit_list(units):
+    ''' input: list of unit dicts
+        returns: new list of interned units
+        '''
+    return [make_unit(u) for u in units]
+
+
+class UnitVocabulary(object):
+    ''' ONE BIT PER DISTINCT UNIT SEEN BY ONE ANALYSIS (OWNED BY ITS ConstraintStore), ASSIGNED ON FIRST USE,
+        SO A LIST OF CANDIDATE UNITS CAN BE SUMMARIZED AS AN int (units_mask).  THE BITS ONLY GROW WITH THE
+        UNITS OF THAT ANALYSIS, NOT WITH EVERY UNIT INTERNED BY THE PROCESS.
+        A UNIT MAY ALSO BE A LIST OF UNITS (eg: THE ALTERNATIVES OF A NESTED ROS MESSAGE), IT GETS ITS OWN BIT
+        '''
+
+    def __init__(self):
+        self.key2bit = {}
+
+    def get_key(self, unit):
+        if isinstance(unit, list):
+            return tuple(self.get_key(u) for u in unit)
+        return make_unit(unit)
+
+    def unit_bit(self, unit):
+        # AN INTERNED PhysUnit IS ITS OWN KEY
+        bit = self.key2bit.get(unit) if type(unit) is PhysUnit else None
+        if bit is None:
+            key = self.get_key(unit)
+            bit = self.key2bit.get(key)
+            if bit is None:
+                bit = 1 << len(self.key2bit)
+                self.key2bit[key] = bit
+        return bit
+
+    def units_mask(self, units):
+        ''' input: list of unit dicts
+            returns: int with the bit of every unit in the list set
+            '''
+        mask = 0
+        unit_bit = self.unit_bit
+        for u in units:
+            mask |= unit_bit(u)
+        return mask
+
+
+def unit_from_str(units_as_str):
+    ''' input: repr of a unit dict, as stored by the type miner, eg: "{'meter': 1.0}"
+        returns: interned PhysUnit
+        '''
+    unit = _str2unit.get(units_as_str)
+    if unit is None:
+        unit = make_unit(eval(units_as_str))
+        _str2unit[units_as_str] = unit
+    return unit
+
+
+def add_exponents(left, right, sign):
+    ''' THE ATTRIBUTES OF A NESTED ROS MESSAGE UNIT HAVE NO EXPONENT:  ONE ONLY ON THE RIGHT IS COPIED,
+        ONE ON BOTH SIDES KEEPS THE LEFT UNIT
+        returns: dict of the exponents of left + sign * right, without the zeros
+        '''
+    exponents = dict(left)
+    for k, v in right.iteritems():
+        if isinstance(v, dict):
+            exponents.setdefault(k, v)
+        elif k not in exponents:
+            exponents[k] = sign * v
+        elif not isinstance(exponents[k], dict):
+            exponents[k] += sign * v
+    return {k: v for k, v in exponents.iteritems() if v != 0}
+
+
+def multiply(left, right):
+    ''' ADD EXPONENTS.  DIMENSIONS WHOSE EXPONENT BECOMES ZERO ARE DROPPED.  None IS NO UNIT
+        returns: interned PhysUnit
+        '''
+    left = make_unit(left or {})
+    right = make_unit(right or {})
+    key = (left, right)
+    unit = _product_cache.get(key)
+    if unit is None:
+        unit = make_unit(add_exponents(left, right, 1))
+        _product_cache[key] = unit
+    return unit
+
+
+def divide(left, right):
+    ''' SUBTRACT EXPONENTS.  DIMENSIONS WHOSE EXPONENT BECOMES ZERO ARE DROPPED.  None IS NO UNIT
+        returns: interned PhysUnit
+        '''
+    left = make_unit(left or {})
+    right = make_unit(right or {})
+    key = (left, right)
+    unit = _quotient_cache.get(key)
+    if unit is None:
+        unit = make_unit(add_exponents(left, right, -1))
+        _quotient_cache[key] = unit
+    return unit
+
+
+def power(unit, exponent):
+    ''' MULTIPLY EVERY EXPONENT BY exponent  (ZERO EXPONENTS ARE KEPT, eg: 'nounit').
+        THE ATTRIBUTES OF A NESTED ROS MESSAGE UNIT ARE KEPT AS THEY ARE
+        returns: interned PhysUnit
+        '''
+    unit = make_unit(unit or {})
+    key = (unit, exponent)
+    result = _scale_cache.get(key)
+    if result is None:
+        result = make_unit({k: (v if isinstance(v, dict) else exponent * v) for k, v in unit.iteritems()})
+        _scale_cache[key] = result
+    return result
+
+
+def sqrt(unit):
+    return power(unit, 0.5)
+
+
+def inverse(unit):
+    return power(unit, -1)
+
+
+NOUNIT = make_unit({'nounit': 0.0})
+WRONG = make_unit({'wrong': 0.0})
+DIMENSIONLESS = make_unit({'dimensionless': 1.0})
+RADIAN = make_unit({'radian': 1.0})
+DEGREE_360 = make_unit({'degree_360': 1.0})
+QUATERNION = make_unit({'quaternion': 1.0})
+RADIAN_UNIT = make_unit({'radian_unit': 1.0})
+DEGREE_360_UNIT = make_unit({'degree_360_unit': 1.0})
+PER_RADIAN_UNIT = make_unit({'radian_unit': -1.0})
+PER_DEGREE_360_UNIT = make_unit({'degree_360_unit': -1.0})
+PER_SECOND = make_unit({'second': -1.0})
+PER_SECOND_SQUARED = make_unit({'second': -2.0})
+DEGREE_360_PER_SECOND = make_unit({'degree_360': 1.0, 'second': -1.0})
+METER_PER_SECOND = make_unit({'meter': 1.0, 'second': -1.0})
+METER_PER_SECOND_SQUARED = make_unit({'meter': 1.0, 'second': -2.0})
@@ -9,7 +9,11 @@ from error_checker import ErrorChecker
 from symbol_helper import SymbolHelper
 from error_rechecker import ErrorRechecker
 from constraint_scoper import ConstraintScoper
+from results_store import ResultsStore
+from result_cache import ResultCache
+import cps_constraints as con
 import click
+import multiprocessing
 import os
 from distutils import spawn
 from subprocess import Popen
@@ -21,6 +25,9 @@ from shutil import copyfile
 # SET PROBABILITY THRESHOLD
 PROB_THRESH = 0.5
 
+# UPPER BOUND ON COLLECT + SOLVE ROUNDS PER FILE (FEWER ARE RUN WHEN THE UNIT RANKING CONVERGES)
+MAX_SOLVE_ROUNDS = 4
+
 
 # SET LOCATIONS OF TRAINING AND TYPES DATA FILES
 # training_filepath = os.path.join('', './DATA/variable_units_2017_09_200K_.txt')
@@ -29,6 +36,19 @@ types_filepath = os.path.join('', './DATA/types_data.txt')
 suffix_filepath = os.path.join('', './DATA/suffix_units_data.txt')
 
 
+# SOURCE FILE EXTENSIONS TREATED AS TRANSLATION UNITS IN WORKSPACE MODE
+TRANSLATION_UNIT_EXTENSIONS = ['.cpp', '.cc', '.cxx']
+
+# PARALLEL WORKSPACE MODE:  NUMBER OF LOCKS GUARDING PER-DIRECTORY cppcheck RUNS
+CPPCHECK_DIR_LOCK_STRIPES = 64
+
+# DEFAULT LOCATION OF THE DUMP AND RESULT CACHE (KEPT OUT OF src/, WHICH MAY BE READ-ONLY)
+DEFAULT_CACHE_DIR = os.path.join(os.path.expanduser('~'), '.cache', 'phys')
+
+# PER-PROCESS STATE OF A PARALLEL WORKSPACE WORKER (SET BY init_workspace_worker)
+workspace_worker_state = {}
+
+
 def eprint(*args, **kwargs):
     print(*args, file=sys.stderr, **kwargs)
 
@@ -43,17 +63,80 @@ def _log(msg):
 @click.option('--should_print_one_line_summary', default='True', help='prints a one-line summary of inconsistencies')
 @click.option('--print_constraints/--no-print_constraints', default='False', help='prints constaints used during analysis.')
 @click.option('--print_variable_types/--no-print_variable_types', default='False', help='For each variable, prints the physical unit type assignment as a probability distribution.')
-def main(target_cpp_file, correction_file, should_print_one_line_summary, print_constraints, print_variable_types):
-    original_directory = os.getcwd()
-
+@click.option('--results_file', default='phys_results.json', help='workspace mode (TARGET_CPP_FILE is a directory): keyed output store for per-file results.')
+@click.option('--jobs', default=1, help='workspace mode: number of worker processes.')
+@click.option('--use_cache/--no-use_cache', default=False, help='reuse cppcheck dumps and results of files whose inputs did not change (kept in --cache_dir, never pruned).')
+@click.option('--cache_dir', default=DEFAULT_CACHE_DIR, help='location of the dump and result cache.')
+def main(target_cpp_file, correction_file, should_print_one_line_summary, print_constraints, print_variable_types, results_file, jobs, use_cache, cache_dir):
     SHOULD_SUPRESS_OUTPUT_FILES = False  # DURING PARALLEL OPERATION
-    SHOULD_USE_CONSTRAINT_SCOPING = False
-   
 
     # - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
     # TEST FOR CPPCHECK
     # - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
     
+    if not is_cppcheck_available():
+        sys.exit(1)
+
+    if not os.path.exists(target_cpp_file):
+        eprint( 'file does not exist: %s' % target_cpp_file)
+        sys.exit(1)
+
+    # - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -  
+    # WORKSPACE MODE:  ANALYZE EVERY TRANSLATION UNIT UNDER A DIRECTORY
+    # - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -  
+
+    if os.path.isdir(target_cpp_file):
+        run_workspace(target_cpp_file, results_file, print_constraints, print_variable_types, jobs, 
+                      cache_dir if use_cache else '')
+        return
+
+    # - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -  
+    # RUN CPPCHECK
+    # - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - 
+
+    result_cache = None
+    dump_key = key = None
+    if use_cache:
+        result_cache = ResultCache(cache_dir, PROB_THRESH)
+        dump_key = result_cache.compute_dump_key(target_cpp_file)
+        key = result_cache.compute_key(dump_key)
+
+    dump_file = prepare_dump_file(target_cpp_file, result_cache, dump_key)
+    if not dump_file:
+        sys.exit(1)
+    source_file = target_cpp_file
+
+
+    if correction_file:
+        rechecker = ErrorRechecker()
+        rechecker.recheck_unit_errors(correction_file, dump_file, source_file)
+        return    
+
+
+    # DO THE MINING
+    my_type_miner = TypeMiner(training_filepath, types_filepath, suffix_filepath)
+    my_type_miner.train(True)  # True = TRY TO REUSE PREVIOUS TRAINING
+
+    constraint_store = con.ConstraintStore()
+    (cppcheck_configuration, var2unitproba, err_checker, nr_solve_rounds) = analyze_file(target_cpp_file, 
+                                                                                          dump_file, 
+                                                                                          my_type_miner, 
+                                                                                          print_constraints, 
+                                                                                          print_variable_types, 
+                                                                                          SHOULD_SUPRESS_OUTPUT_FILES, 
+                                                                                          constraint_store)
+
+    # MAKE THE RESULT AVAILABLE TO LATER WORKSPACE RUNS
+    if result_cache:
+        result_cache.store_result(key, var2unitproba, 
+                                  ResultsStore.make_record(collect_variable_units(cppcheck_configuration, 
+                                                                                         var2unitproba, 
+                                                                                         constraint_store), 
+                                                           err_checker, 
+                                                           nr_solve_rounds))
+
+
+def is_cppcheck_available():
     if not spawn.find_executable('cppcheck'):
         # CPPCHECK NOT GLOBALLY INSTALLED, CHECK BIN DIRECTORY
         if not os.path.exists('bin/cppcheck'):
@@ -61,19 +144,38 @@ def main(target_cpp_file, correction_file, should_print_one_line_summary, print_
             eprint( 'two options: ')
             eprint( '  1.  sudo apt-get install cppcheck')  #todo
             eprint( '  2.  brew install cppcheck')  #todo
-            sys.exit(1)
-
-    # - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -  
-    # RUN CPPCHECK
-    # - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - 
-    # EXTRACT DIR
-
-    if not os.path.exists(target_cpp_file):
-        eprint( 'file does not exist: %s' % target_cpp_file)
-        sys.exit(1)
+            return False
+    return True
+
+
+def prepare_dump_file(target_cpp_file, result_cache=None, dump_key=None, dir_lock=None):
+    ''' input: path to a .cpp file, optional ResultCache and the dump key of the file
+        returns: path to a dump matching the current inputs (cached or fresh), or None if cppcheck failed
+        '''
+    if result_cache:
+        cached_dump_file = result_cache.get_dump_file(dump_key)
+        if cached_dump_file:
+            eprint( "Reusing cached cppcheck 'dump' file %s" % cached_dump_file)
+            return cached_dump_file
+
+    dump_file = run_cppcheck(target_cpp_file, dir_lock)
+    if dump_file and result_cache:
+        return result_cache.store_dump_file(dump_key, dump_file)
+    return dump_file
+
+
+def run_cppcheck(target_cpp_file, dir_lock=None):
+    ''' RUN CPPCHECK ON A SOURCE FILE.  AN EXISTING DUMP NEXT TO THE SOURCE MAY BE STALE, 
+        SO IT IS ALWAYS REGENERATED (REUSE GOES THROUGH THE ResultCache)
+        input: path to a .cpp file, 
+               optional lock held while the shared cfg/ folder of its directory is in use
+        returns: path to the cppcheck 'dump' file, or None if cppcheck failed
+        '''
+    original_directory = os.getcwd()
 
     eprint( 'Processing file %s' % target_cpp_file)
     eprint( 'Attempting to run cppcheck...')
+    # EXTRACT DIR
     target_cpp_file_dir = os.path.dirname(target_cpp_file)
     eprint( 'Changing directory to %s' % target_cpp_file_dir)
     os.chdir(target_cpp_file_dir)
@@ -81,50 +183,56 @@ def main(target_cpp_file, correction_file, should_print_one_line_summary, print_
     target_cpp_file_base_name = os.path.basename(target_cpp_file)
     dump_filename = os.path.basename(target_cpp_file) + '.dump'
 
-    if not os.path.exists(dump_filename):
+    if dir_lock:
+        dir_lock.acquire()
+    try:
         args = ['cppcheck', '--dump', '-I ../include', target_cpp_file_base_name]
         # CREATE CPPCHECK FILE
-	made_cfg_dir = False
+        made_cfg_dir = False
         if not os.path.exists('cfg'):
             os.makedirs('cfg')
-	    made_cfg_dir = True
-	copyfile(os.path.join(original_directory, os.path.join('DATA', 'std.cfg')), os.path.join(os.path.join(target_cpp_file_dir, 'cfg'), 'std.cfg'))
+            made_cfg_dir = True
+        copyfile(os.path.join(original_directory, os.path.join('DATA', 'std.cfg')), os.path.join(os.path.join(target_cpp_file_dir, 'cfg'), 'std.cfg'))
         cppcheck_process = Popen(' '.join(args),  shell=True)
         cppcheck_process.communicate()
         if cppcheck_process.returncode != 0:
             eprint( 'cppcheck appears to have failed..exiting with return code %d' % cppcheck_process.returncode)
-            sys.exit(1)
+            return None
         eprint( "Created cppcheck 'dump' file %s" % dump_filename)
         # CLEAN UP CREATE OF CPPCHECK FILE
         if os.path.exists('cfg/std.cfg'):
             try:
                 os.remove('cfg/std.cfg')
-		if made_cfg_dir:
-		    os.rmdir('cfg')
+                if made_cfg_dir:
+                    os.rmdir('cfg')
             except:
                 # eprint('problem removing cfg folder')
                 pass # todo - fail silently for now
+    finally:
+        if dir_lock:
+            dir_lock.release()
+        # RETURN TO HOME
+        os.chdir(original_directory)
+
+    return os.path.join(os.path.dirname(target_cpp_file), dump_filename)
+
+
+def analyze_file(target_cpp_file, dump_file, my_type_miner, 
+                 print_constraints, print_variable_types, should_supress_output_files, constraint_store=None):
+    ''' COLLECT AND SOLVE CONSTRAINTS, THEN CHECK ONE FILE FOR UNIT ERRORS
+        input: source file, its cppcheck dump file, a trained TypeMiner,
+               the ConstraintStore that holds the constraints of this analysis (a new one if None)
+        returns: tuple (cppcheck configuration, var2unitproba, ErrorChecker, number of solve rounds)
+        '''
+    SHOULD_USE_CONSTRAINT_SCOPING = False
+    source_file = target_cpp_file
 
-    # RETURN TO HOME
-    os.chdir(original_directory)
-
-    dump_file = os.path.join(os.path.dirname(target_cpp_file), dump_filename)
-    source_file = dump_file.replace('.dump','')
-
-
-    if correction_file:
-        rechecker = ErrorRechecker()
-        rechecker.recheck_unit_errors(correction_file, dump_file, source_file)
-        return    
-
-
-    # DO THE MINING
-    my_type_miner = TypeMiner(training_filepath, types_filepath, suffix_filepath)
-    my_type_miner.train(True)  # True = TRY TO REUSE PREVIOUS TRAINING
+    if constraint_store is None:
+        constraint_store = con.ConstraintStore()
 
-    con_collector = ConstraintCollector(my_type_miner)
+    con_collector = ConstraintCollector(my_type_miner, constraint_store)
     con_collector.SHOULD_PRINT_CONSTRAINTS = print_constraints
-    con_scoper = ConstraintScoper()
+    con_scoper = ConstraintScoper(constraint_store)
     con_solver = ConstraintSolver(con_collector, con_scoper, SHOULD_USE_CONSTRAINT_SCOPING)
     con_solver.SHOULD_PRINT_VARIABLE_TYPES = print_variable_types
     
@@ -132,43 +240,27 @@ def main(target_cpp_file, correction_file, should_print_one_line_summary, print_
     # COLLECT CONSTRAINTS    
     con_collector.main_run_collect(dump_file, source_file)
 
-    _log("Solving Constraints 1 ... %s " % strftime("%Y-%m-%d %H:%M:%S", gmtime()))
-    # SOLVE CONSTRAINTS    
-    var2unitproba = con_solver.solve()
-
-    _log("Solving Constraints 2 ... %s " % strftime("%Y-%m-%d %H:%M:%S", gmtime()))
-    # REPEAT
-    con_collector.repeat_run_collect(2)
-    var2unitproba = con_solver.solve()
-
-    _log("Solving Constraints 3 ... %s " % strftime("%Y-%m-%d %H:%M:%S", gmtime()))
-    # REPEAT
-    con_collector.repeat_run_collect(3)
-    var2unitproba = con_solver.solve()
-
-    # REPEAT
-    _log("Solving Constraints 4 ... %s " % strftime("%Y-%m-%d %H:%M:%S", gmtime()))
-    con_collector.repeat_run_collect(4)
-    var2unitproba = con_solver.solve()
+    # SOLVE CONSTRAINTS, REPEAT UNTIL THE UNIT RANKING IS STABLE
+    (var2unitproba, nr_solve_rounds) = solve_until_stable(con_collector, con_solver)
 
     # APPLY NEW UNITS
     con_collector.repeat_run_propagate(PROB_THRESH)
 
     # PRINT VARIABLE-UNITS LIST TO FILE
-    if not SHOULD_SUPRESS_OUTPUT_FILES:
-        print_variable_units(con_collector.configurations[0], var2unitproba)
+    if not should_supress_output_files:
+        print_variable_units(con_collector.configurations[0], var2unitproba, constraint_store)
 
     # COLLECT ERRORS
-    err_checker = ErrorChecker(dump_file, source_file)
+    err_checker = ErrorChecker(dump_file, source_file, constraint_store)
     err_checker.current_file_under_analysis = target_cpp_file    
     err_checker.check_unit_errors(con_collector.configurations[0], con_collector.all_sorted_analysis_unit_dicts[0])
 
     # PRINT ERRORS TO FILE
-    if not SHOULD_SUPRESS_OUTPUT_FILES:
+    if not should_supress_output_files:
         err_checker.print_unit_errors('errors.txt')
         err_checker.print_var_units_to_check('variable_units_to_check.txt')
 
-        rechecker = ErrorRechecker()
+        rechecker = ErrorRechecker(constraint_store)
         rechecker.store_state(con_collector.configurations[0], 
                               err_checker.all_errors, 
                               err_checker.variable_units_to_check_as_list)
@@ -178,50 +270,268 @@ def main(target_cpp_file, correction_file, should_print_one_line_summary, print_
     if SHOULD_USE_CONSTRAINT_SCOPING:
          compute_results_for_constraint_scopes(target_cpp_file, dump_file, source_file, 
                                                con_collector, con_solver, con_scoper)
+
+    return (con_collector.configurations[0], var2unitproba, err_checker, nr_solve_rounds)
+
+
+def solve_until_stable(con_collector, con_solver, max_rounds=MAX_SOLVE_ROUNDS):
+    ''' ROUND 1 SOLVES THE CONSTRAINTS OF THE FIRST COLLECTION.  EVERY LATER ROUND RE-COLLECTS WITH THE
+        UNITS OF THE PREVIOUS ROUND AND SOLVES AGAIN.  A COLLECTION READS THE RANKING OF THE PREVIOUS 
+        ROUND, BUT ALSO ADDS TO THE CONSTRAINT TABLES THAT ARE NOT RESET BETWEEN ROUNDS.  THE LOOP STOPS 
+        WHEN A ROUND LEAVES THE RANKING UNCHANGED AND ADDS NO NEW DISTINCT CONSTRAINT.  THE ROUNDS IT 
+        SKIPS WOULD ONLY APPEND MORE COPIES OF THE SAME ks (AND cf) CONSTRAINTS, WHICH WEIGH THAT 
+        EVIDENCE MORE BUT ADD NONE
+        input: ConstraintCollector after main_run_collect, its ConstraintSolver, cap on the number of rounds
+        returns: tuple (var2unitproba of the last round, number of solve rounds)
+        '''
+    _log("Solving Constraints 1 ... %s " % strftime("%Y-%m-%d %H:%M:%S", gmtime()))
+    unit_prob_threshold = con_collector.con.unit_prob_threshold
+    var2unitproba = con_solver.solve()
+    ranking = get_unit_ranking(var2unitproba, unit_prob_threshold)
+    constraint_counts = con_collector.con.get_distinct_constraint_counts()
+    nr_rounds = 1
+
+    while nr_rounds < max_rounds:
+        nr_rounds += 1
+        _log("Solving Constraints %d ... %s " % (nr_rounds, strftime("%Y-%m-%d %H:%M:%S", gmtime())))
+        con_collector.repeat_run_collect(nr_rounds)
+        var2unitproba = con_solver.solve()
+        previous_ranking = ranking
+        ranking = get_unit_ranking(var2unitproba, unit_prob_threshold)
+        previous_constraint_counts = constraint_counts
+        constraint_counts = con_collector.con.get_distinct_constraint_counts()
+        if (ranking == previous_ranking) and (constraint_counts == previous_constraint_counts):
+            break
+
+    _log("Solved constraints in %d rounds" % nr_rounds)
+    counts = con_solver.compaction_counts
+    _log("Factor graphs compacted from %d to %d factors (%d merged, %d constant), %d to %d variables" % 
+         (counts['factors_in'], counts['factors_out'], counts['merged'], counts['constant'], 
+          counts['vars_in'], counts['vars_out']))
+    return (var2unitproba, nr_rounds)
+
+
+def get_unit_ranking(var2unitproba, unit_prob_threshold):
+    ''' WHAT THE NEXT COLLECTION READS FROM A SOLVE (apply_previous_round_units, apply_previous_round_top3_units):
+        FOR EACH VARIABLE, ITS UNITS ABOVE unit_prob_threshold, GROUPED BY EQUAL PROBABILITY, BEST FIRST
+        input: var2unitproba as returned by ConstraintSolver.solve (each list sorted, highest probability first),
+               the unit_prob_threshold of the ConstraintStore
+        returns: {(variable, name): tuple of frozensets of str(unit)}
+        '''
+    ranking = {}
+    for (key, unitprobalist) in var2unitproba.iteritems():
+        groups = []
+        last_proba = None
+        for (unit, proba) in unitprobalist:
+            proba = round(proba, 7)
+            if proba <= unit_prob_threshold:
+                break
+            if proba != last_proba:
+                groups.append(set())
+                last_proba = proba
+            groups[-1].add(str(unit))
+        ranking[key] = tuple(frozenset(g) for g in groups)
+    return ranking
+
+
+def discover_translation_units(workspace_dir):
+    ''' WALK A WORKSPACE (E.G. A CATKIN TREE) AND COLLECT ITS C++ TRANSLATION UNITS
+        input: directory
+        returns: sorted list of source file paths
+        '''
+    source_files = []
+    for (dirpath, dirnames, filenames) in os.walk(workspace_dir):
+        # SKIP HIDDEN DIRECTORIES (.git, .svn, ...)
+        dirnames[:] = [d for d in dirnames if not d.startswith('.')]
+        for filename in filenames:
+            if os.path.splitext(filename)[1] in TRANSLATION_UNIT_EXTENSIONS:
+                source_files.append(os.path.join(dirpath, filename))
+    return sorted(source_files)
+
+
+def run_workspace(workspace_dir, results_file, print_constraints, print_variable_types, jobs=1, cache_dir=''):
+    ''' ANALYZE EVERY TRANSLATION UNIT UNDER workspace_dir, IN THIS PROCESS OR IN jobs WORKER PROCESSES.
+        THE MINER (AND ITS PREDICTION MEMO) AND THE INFERENCE SETUP STAY WARM ACROSS FILES,
+        RESULTS ARE WRITTEN INTO ONE KEYED STORE INSTEAD OF errors.txt / variables.txt.
+        WITH A cache_dir, FILES WHOSE INPUTS DID NOT CHANGE ARE TAKEN FROM THE ResultCache
+        '''
+    source_files = order_by_expected_cost(discover_translation_units(workspace_dir))
+    eprint( 'Found %d translation units under %s' % (len(source_files), workspace_dir))
+
+    store = ResultsStore(results_file)
+    store.load()
+
+    result_cache = None
+    if cache_dir:
+        result_cache = ResultCache(cache_dir, PROB_THRESH)
+
+    if jobs > 1:
+        for (target_cpp_file, result) in run_workspace_in_parallel(source_files, jobs, 
+                                                                    print_constraints, 
+                                                                    print_variable_types, 
+                                                                    cache_dir):
+            store.add(target_cpp_file, result)
+    else:
+        # DO THE MINING ONCE
+        my_type_miner = TypeMiner(training_filepath, types_filepath, suffix_filepath)
+        my_type_miner.train(True)  # True = TRY TO REUSE PREVIOUS TRAINING
+
+        for target_cpp_file in source_files:
+            store.add(target_cpp_file, 
+                      analyze_workspace_file(target_cpp_file, my_type_miner, print_constraints, print_variable_types, 
+                                             None, result_cache))
+
+    store.save()
+    eprint( 'Analyzed %d files (%d failed), results in %s' % (len(source_files), 
+                                                             store.count_by_status('failed'), 
+                                                             results_file))
+
+
+def order_by_expected_cost(source_files):
+    ''' LONGEST-PROCESSING-TIME-FIRST ORDER: THE BIGGEST FILES ARE HANDED OUT FIRST SO THAT
+        NO WORKER PICKS UP A HUGE FILE AT THE VERY END OF THE RUN.
+        COST ESTIMATE IS THE SIZE OF AN EXISTING DUMP FILE, OTHERWISE THE SIZE OF THE SOURCE
+        '''
+    def expected_cost(target_cpp_file):
+        dump_file = target_cpp_file + '.dump'
+        if os.path.exists(dump_file):
+            return os.path.getsize(dump_file)
+        return os.path.getsize(target_cpp_file)
+    return sorted(source_files, key=expected_cost, reverse=True)
+
+
+def run_workspace_in_parallel(source_files, jobs, print_constraints, print_variable_types, cache_dir=''):
+    ''' SPREAD FILES OVER jobs WORKER PROCESSES.  EACH WORKER ANALYZES ONE FILE AT A TIME,
+        EVERY FILE WITH ITS OWN ConstraintStore.  FILES ARE HANDED OUT ONE BY ONE
+        (chunksize=1), SO A WORKER THAT FINISHES EARLY TAKES THE NEXT FILE FROM THE SHARED QUEUE.
+        yields: (source file, result record) in completion order
+        '''
+    # cppcheck NEEDS A cfg/ FOLDER NEXT TO THE SOURCE, FILES OF ONE DIRECTORY SHARE IT
+    dir_locks = [multiprocessing.Lock() for i in range(CPPCHECK_DIR_LOCK_STRIPES)]
+    pool = multiprocessing.Pool(jobs, 
+                                init_workspace_worker, 
+                                (dir_locks, print_constraints, print_variable_types, cache_dir))
+    try:
+        for (target_cpp_file, result) in pool.imap_unordered(analyze_in_workspace_worker, source_files, 1):
+            yield (target_cpp_file, result)
+        pool.close()
+    except:
+        pool.terminate()
+        raise
+    finally:
+        pool.join()
+
+
+def init_workspace_worker(dir_locks, print_constraints, print_variable_types, cache_dir):
+    # DO THE MINING ONCE PER WORKER
+    my_type_miner = TypeMiner(training_filepath, types_filepath, suffix_filepath)
+    my_type_miner.train(True)  # True = TRY TO REUSE PREVIOUS TRAINING
+    workspace_worker_state['type_miner'] = my_type_miner
+    workspace_worker_state['result_cache'] = ResultCache(cache_dir, PROB_THRESH) if cache_dir else None
+    workspace_worker_state['dir_locks'] = dir_locks
+    workspace_worker_state['print_constraints'] = print_constraints
+    workspace_worker_state['print_variable_types'] = print_variable_types
+
+
+def analyze_in_workspace_worker(target_cpp_file):
+    s = workspace_worker_state
+    dir_locks = s['dir_locks']
+    dir_lock = dir_locks[hash(os.path.dirname(os.path.abspath(target_cpp_file))) % len(dir_locks)]
+    return (target_cpp_file, 
+            analyze_workspace_file(target_cpp_file, s['type_miner'], 
+                                   s['print_constraints'], s['print_variable_types'], 
+                                   dir_lock, s['result_cache']))
+
+
+def analyze_workspace_file(target_cpp_file, my_type_miner, print_constraints, print_variable_types, 
+                           dir_lock=None, result_cache=None):
+    ''' ANALYZE ONE FILE OF A WORKSPACE.  A FAILURE ONLY FAILS THIS FILE.
+        returns: result record for the ResultsStore
+        '''
+    # EACH FILE STARTS FROM A FRESH ConstraintStore
+    constraint_store = con.ConstraintStore()
+    try:
+        dump_key = key = None
+        if result_cache:
+            dump_key = result_cache.compute_dump_key(target_cpp_file)
+            key = result_cache.compute_key(dump_key)
+            cached_result = result_cache.get_result(key)
+            if cached_result:
+                eprint( 'Reusing cached result for %s' % target_cpp_file)
+                return cached_result['record']
+        dump_file = prepare_dump_file(target_cpp_file, result_cache, dump_key, dir_lock)
+        if not dump_file:
+            return ResultsStore.make_failed_record('cppcheck failed')
+        (cppcheck_configuration, var2unitproba, err_checker, nr_solve_rounds) = analyze_file(target_cpp_file, 
+                                                                                              dump_file, 
+                                                                                              my_type_miner, 
+                                                                                              print_constraints, 
+                                                                                              print_variable_types, 
+                                                                                              True, 
+                                                                                              constraint_store)
+        record = ResultsStore.make_record(collect_variable_units(cppcheck_configuration, 
+                                                                 var2unitproba, 
+                                                                 constraint_store), 
+                                          err_checker, 
+                                          nr_solve_rounds)
+        if result_cache:
+            result_cache.store_result(key, var2unitproba, record)
+    except Exception as e:
+        eprint( 'analysis of %s failed: %s' % (target_cpp_file, repr(e)))
+        return ResultsStore.make_failed_record(repr(e))
+    return record
     
 
-def print_variable_units(a_cppcheck_configuration, var2unitproba):
-    my_symbol_helper = SymbolHelper()
-    var_dict = {}
+def print_variable_units(a_cppcheck_configuration, var2unitproba, constraint_store):
     with open('variables.txt', 'w') as f:
-        for t in a_cppcheck_configuration.tokenlist:
-            if t.variable:
-                if t.is_unit_propagation_based_on_unknown_variable:
-                    #continue
-                    pass
-
-                #print t.str + ': ' + str(t.units)
-                (t, name) = my_symbol_helper.find_compound_variable_and_name_for_variable_token(t)
-                if not t:
-                    continue
-                #eprint("%s, %s, %s" % (name, t.str, t.varId))
-
-                if not my_symbol_helper.should_have_unit(t, name):
-                    continue
-                    
-                if (t.variable.Id, name) not in var_dict:
-                    var_dict[(t.variable.Id, name)] = []
-
-                for unit in t.units:
-                    if unit not in var_dict[(t.variable.Id, name)]:
-                        var_dict[(t.variable.Id, name)].append(unit)
-
-                if (t.variable, name) in var2unitproba:
-                    if len(var2unitproba[(t.variable, name)]) >= 2:
-                        unit, proba = var2unitproba[(t.variable, name)][0]
-                        unit2, proba2 = var2unitproba[(t.variable, name)][1]
-                    else:
-                        unit, proba = var2unitproba[(t.variable, name)][0]
-                        proba2 = 0.0
-                    proba = round(proba, 7)
-                    proba2 = round(proba2, 7)
-                    if (proba > 0.5) and (proba != proba2): #and (unit not in var_dict[(t.variable.Id, name)]):
-                        #var_dict[(t.variable.Id, name)].append(unit)
-                        var_dict[(t.variable.Id, name)] = [unit]
-            
-        for (var_id, var_name) in var_dict: 
-            var_units = var_dict[(var_id, var_name)]
+        for (var_id, var_name, var_units) in collect_variable_units(a_cppcheck_configuration, 
+                                                                    var2unitproba, 
+                                                                    constraint_store):
             f.write("%s, %s, %s\n" % (var_id, var_name, var_units))
+
+
+def collect_variable_units(a_cppcheck_configuration, var2unitproba, constraint_store):
+    ''' input: analyzed cppcheck configuration, the solved var2unitproba and the ConstraintStore of the analysis
+        returns: list of (var_id, var_name, units) in the order written to variables.txt
+        '''
+    my_symbol_helper = SymbolHelper(constraint_store)
+    var_dict = {}
+    for t in a_cppcheck_configuration.tokenlist:
+        if t.variable:
+            if t.is_unit_propagation_based_on_unknown_variable:
+                #continue
+                pass
+
+            #print t.str + ': ' + str(t.units)
+            (t, name) = my_symbol_helper.find_compound_variable_and_name_for_variable_token(t)
+            if not t:
+                continue
+            #eprint("%s, %s, %s" % (name, t.str, t.varId))
+
+            if not my_symbol_helper.should_have_unit(t, name):
+                continue
+                
+            if (t.variable.Id, name) not in var_dict:
+                var_dict[(t.variable.Id, name)] = []
+
+            for unit in t.units:
+                if unit not in var_dict[(t.variable.Id, name)]:
+                    var_dict[(t.variable.Id, name)].append(unit)
+
+            if (t.variable, name) in var2unitproba:
+                if len(var2unitproba[(t.variable, name)]) >= 2:
+                    unit, proba = var2unitproba[(t.variable, name)][0]
+                    unit2, proba2 = var2unitproba[(t.variable, name)][1]
+                else:
+                    unit, proba = var2unitproba[(t.variable, name)][0]
+                    proba2 = 0.0
+                proba = round(proba, 7)
+                proba2 = round(proba2, 7)
+                if (proba > 0.5) and (proba != proba2): #and (unit not in var_dict[(t.variable.Id, name)]):
+                    #var_dict[(t.variable.Id, name)].append(unit)
+                    var_dict[(t.variable.Id, name)] = [unit]
+        
+    return [(var_id, var_name, var_dict[(var_id, var_name)]) for (var_id, var_name) in var_dict]
     
 
 def compute_results_for_constraint_scopes(target_cpp_file, dump_file, source_file, 
@@ -241,7 +551,7 @@ def compute_results_for_constraint_scopes(target_cpp_file, dump_file, source_fil
         con_collector.repeat_run_propagate(PROB_THRESH)
 
         # COLLECT ERRORS
-        err_checker = ErrorChecker(dump_file, source_file)
+        err_checker = ErrorChecker(dump_file, source_file, con_collector.con)
         err_checker.current_file_under_analysis = target_cpp_file    
         err_checker.check_unit_errors(con_collector.configurations[0], con_collector.all_sorted_analysis_unit_dicts[0])
 
@@ -0,0 +1,171 @@
+#!/usr/bin/env python
+
+import cPickle as pickle
+import hashlib
+import os
+import re
+from shutil import copyfile
+from subprocess import Popen, PIPE
+
+
+# BUMP WHEN THE LAYOUT OF A CACHE ENTRY (OR THE ANALYSIS ITSELF) CHANGES
+CACHE_FORMAT_VERSION = '7'
+
+# BUMP WHEN THE WAY CPPCHECK IS RUN TO PRODUCE A DUMP CHANGES
+DUMP_FORMAT_VERSION = '1'
+
+INCLUDE_PATTERN = re.compile(r'^\s*#\s*include\s*([<"])([^>"]+)[>"]', re.MULTILINE)
+
+
+class ResultCache:
+    ''' CONTENT-ADDRESSED CACHE OF CPPCHECK DUMPS AND ANALYSIS RESULTS.
+        THE DUMP KEY IS A HASH OF EVERYTHING THAT DETERMINES THE DUMP OF A FILE:
+            - THE SOURCE FILE AND EVERY HEADER IT (TRANSITIVELY) INCLUDES THAT CPPCHECK CAN SEE
+            - THE CPPCHECK VERSION
+        THE RESULT KEY ADDS WHAT ELSE DETERMINES THE RESULT OF THE FILE:
+            - PROB_THRESH
+            - THE MODEL FILES IN DATA/ (INCLUDING std.cfg)
+        SO A CHANGE OF THE MODEL OR THRESHOLD REUSES THE DUMP (<dump key>.dump) BUT NOT 
+        THE RESULT (<result key>.pkl)
+        '''
+
+    def __init__(self, cache_dir, prob_thresh, data_dir='DATA'):
+        self.cache_dir = cache_dir
+        self.prob_thresh = prob_thresh
+        self.data_dir = data_dir
+        self.cppcheck_version = None
+        self.model_digest = None
+        if not os.path.exists(self.cache_dir):
+            os.makedirs(self.cache_dir)
+
+
+    def compute_dump_key(self, target_cpp_file):
+        ''' input: path to a .cpp file
+            returns: hex digest identifying the cppcheck dump of that file
+            '''
+        h = hashlib.sha1()
+        h.update(DUMP_FORMAT_VERSION + '\n')
+        h.update(self.get_cppcheck_version() + '\n')
+        for (include_name, path) in self.find_input_files(target_cpp_file):
+            h.update(include_name + '\n')
+            with open(path, 'rb') as f:
+                h.update(f.read())
+        return h.hexdigest()
+
+
+    def compute_key(self, dump_key):
+        ''' input: dump key of a .cpp file (compute_dump_key)
+            returns: hex digest identifying the analysis of that file
+            '''
+        h = hashlib.sha1()
+        h.update(CACHE_FORMAT_VERSION + '\n')
+        h.update(dump_key + '\n')
+        h.update(repr(self.prob_thresh) + '\n')
+        h.update(self.get_model_digest() + '\n')
+        return h.hexdigest()
+
+
+    def get_cppcheck_version(self):
+        if self.cppcheck_version is None:
+            try:
+                cppcheck_process = Popen(['cppcheck', '--version'], stdout=PIPE)
+                self.cppcheck_version = cppcheck_process.communicate()[0].strip()
+            except OSError:
+                self.cppcheck_version = ''
+        return self.cppcheck_version
+
+
+    def get_model_digest(self):
+        if self.model_digest is None:
+            h = hashlib.sha1()
+            for (dirpath, dirnames, filenames) in os.walk(self.data_dir):
+                dirnames.sort()
+                for filename in sorted(filenames):
+                    h.update(filename + '\n')
+                    with open(os.path.join(dirpath, filename), 'rb') as f:
+                        h.update(f.read())
+            self.model_digest = h.hexdigest()
+        return self.model_digest
+
+
+    def find_input_files(self, target_cpp_file):
+        ''' RESOLVE #include DIRECTIVES THE WAY THE DRIVER RUNS CPPCHECK ( -I ../include )
+            input: path to a .cpp file
+            returns: list of (include name, path), source file first, in discovery order
+            '''
+        include_dir = os.path.join(os.path.dirname(target_cpp_file), '..', 'include')
+        input_files = [(os.path.basename(target_cpp_file), target_cpp_file)]
+        seen = set([os.path.abspath(target_cpp_file)])
+        i = 0
+        while i < len(input_files):
+            (name, path) = input_files[i]
+            i += 1
+            with open(path) as f:
+                text = f.read()
+            for (delimiter, include_name) in INCLUDE_PATTERN.findall(text):
+                search_dirs = [include_dir]
+                if delimiter == '"':
+                    search_dirs = [os.path.dirname(path), include_dir]
+                for d in search_dirs:
+                    candidate = os.path.join(d, include_name)
+                    if os.path.isfile(candidate):
+                        if os.path.abspath(candidate) not in seen:
+                            seen.add(os.path.abspath(candidate))
+                            input_files.append((include_name, candidate))
+                        break
+        return input_files
+
+
+    def get_dump_file(self, dump_key):
+        ''' returns: path of the cached dump for this dump key, or None
+            '''
+        dump_file = os.path.join(self.cache_dir, dump_key + '.dump')
+        if os.path.exists(dump_file):
+            return dump_file
+        return None
+
+
+    def store_dump_file(self, dump_key, dump_file):
+        ''' COPY A FRESH DUMP INTO THE CACHE (WRITE TO A TEMP NAME FIRST, PARALLEL WORKERS MAY RACE)
+            returns: path of the cached dump
+            '''
+        cached_dump_file = os.path.join(self.cache_dir, dump_key + '.dump')
+        tmp_file = '%s.%d.tmp' % (cached_dump_file, os.getpid())
+        copyfile(dump_file, tmp_file)
+        os.rename(tmp_file, cached_dump_file)
+        return cached_dump_file
+
+
+    def get_result(self, key):
+        ''' returns: cached result dict {'var2unitproba', 'record'} for this key, or None
+            '''
+        result_file = os.path.join(self.cache_dir, key + '.pkl')
+        if not os.path.exists(result_file):
+            return None
+        try:
+            with open(result_file, 'rb') as f:
+                return pickle.load(f)
+        except Exception:
+            # CORRUPT OR INCOMPATIBLE ENTRY, TREAT AS A MISS
+            return None
+
+
+    def store_result(self, key, var2unitproba, record):
+        ''' input: var2unitproba as returned by the solver (keyed by cppcheck Variable objects)
+                   and the ResultsStore record of the file
+            '''
+        result = {'var2unitproba': self.make_portable_var2unitproba(var2unitproba),
+                  'record': record}
+        result_file = os.path.join(self.cache_dir, key + '.pkl')
+        tmp_file = '%s.%d.tmp' % (result_file, os.getpid())
+        with open(tmp_file, 'wb') as f:
+            pickle.dump(result, f, pickle.HIGHEST_PROTOCOL)
+        os.rename(tmp_file, result_file)
+
+
+    @staticmethod
+    def make_portable_var2unitproba(var2unitproba):
+        ''' VARIABLE OBJECTS DO NOT OUTLIVE THE PARSE, KEY BY (variable.Id, name) INSTEAD
+            '''
+        return {(variable.Id, name): unitprobalist
+                for ((variable, name), unitprobalist) in var2unitproba.items()}
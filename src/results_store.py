@@ -0,0 +1,66 @@
+#!/usr/bin/env python
+
+import json
+import os
+
+
+class ResultsStore:
+    ''' KEYED OUTPUT STORE FOR WORKSPACE RUNS.  ONE RECORD PER TRANSLATION UNIT,
+        KEYED BY SOURCE FILE PATH, WRITTEN AS A SINGLE JSON FILE
+        '''
+
+    def __init__(self, results_file):
+        self.results_file = results_file
+        self.file2result = {}
+
+
+    def load(self):
+        ''' READ A PREVIOUS STORE (IF ANY) SO NEW RESULTS ARE MERGED INTO IT
+            returns: None
+            '''
+        if os.path.exists(self.results_file):
+            with open(self.results_file) as f:
+                self.file2result = json.load(f)
+
+
+    def add(self, source_file, result):
+        self.file2result[source_file] = result
+
+
+    def save(self):
+        with open(self.results_file, 'w') as f:
+            json.dump(self.file2result, f, indent=1, sort_keys=True)
+
+
+    def count_by_status(self, status):
+        return len([r for r in self.file2result.values() if r['status'] == status])
+
+
+    @staticmethod
+    def make_record(variable_units, err_checker, nr_solve_rounds=0):
+        ''' BUILD THE RECORD OF ONE SUCCESSFULLY ANALYZED FILE
+            input: list of (var_id, var_name, units), the ErrorChecker that ran on the file
+                   and the number of collect + solve rounds it took
+            returns: dict
+            '''
+        errors = [{'linenr': e.linenr,
+                   'var_name': e.var_name,
+                   'error_type': err_checker.ERROR_TYPE_TEXT[e.ERROR_TYPE],
+                   'is_warning': e.is_warning} for e in err_checker.all_errors]
+        return {'status': 'ok',
+                'message': '',
+                'summary': {'strong': len([e for e in errors if not e['is_warning']]),
+                            'weak': len([e for e in errors if e['is_warning']]),
+                            'rounds': nr_solve_rounds},
+                'errors': errors,
+                'variables': [{'var_id': var_id, 'var_name': var_name, 'units': units}
+                              for (var_id, var_name, units) in variable_units]}
+
+
+    @staticmethod
+    def make_failed_record(message):
+        return {'status': 'failed',
+                'message': message,
+                'summary': {'strong': 0, 'weak': 0, 'rounds': 0},
+                'errors': [],
+                'variables': []}
@@ -0,0 +1,90 @@
+#!/usr/bin/env python
+
+import ast
+import os
+from os.path import join, dirname
+import phys_unit
+
+
+# ONE REGISTRY PER PROCESS, SHARED BY EVERY SymbolHelper.  BUILT ON FIRST USE FROM ros_units.conf, THEN FROM
+# THE FILES LISTED (os.pathsep SEPARATED) IN $PHYS_ROS_UNIT_FILES, WHICH ADD CLASSES OR REPLACE THEM WHOLE
+ROS_UNITS_FILE = join(dirname(__file__), 'ros_units.conf')
+SITE_ROS_UNIT_FILES_VARIABLE = 'PHYS_ROS_UNIT_FILES'
+
+
+class FrozenDict(dict):
+    ''' A dict THAT REFUSES EVERY WRITE, SO NO CALLER CAN CHANGE THE SHARED REGISTRY
+        '''
+
+    def _raise_immutable(self, *args, **kwargs):
+        raise TypeError('the ROS unit registry is shared and immutable')
+
+    __setitem__ = __delitem__ = clear = pop = popitem = setdefault = update = _raise_immutable
+
+    def __reduce__(self):
+        return (FrozenDict, (dict(self),))
+
+
+def read_ros_unit_file(filename):
+    ''' input: a file holding one dict literal, {class name: {attribute: {base dimension: exponent}}}
+        returns: that dict
+        '''
+    with open(filename) as f:
+        class2attributes = ast.literal_eval(f.read())
+    if not isinstance(class2attributes, dict):
+        raise ValueError('%s: expected a dict of ROS message classes' % filename)
+    return class2attributes
+
+
+def freeze_attributes(attribute2unit):
+    ''' INTERN EVERY UNIT SO TOKENS SHARE ONE IMMUTABLE INSTANCE PER UNIT
+        (NESTED MESSAGES, eg: MultiDOFJointState.twist, STAY dicts, FROZEN)
+        '''
+    frozen = {}
+    for (attribute, unit) in attribute2unit.items():
+        if all(isinstance(v, float) for v in unit.values()):
+            frozen[attribute] = phys_unit.make_unit(unit)
+        else:
+            frozen[attribute] = FrozenDict((k, FrozenDict(v)) for (k, v) in unit.items())
+    return FrozenDict(frozen)
+
+
+def load_ros_unit_registry(filenames):
+    class2attributes = {}
+    for filename in filenames:
+        for (class_name, attribute2unit) in read_ros_unit_file(filename).items():
+            class2attributes[class_name] = freeze_attributes(attribute2unit)
+    return FrozenDict(class2attributes)
+
+
+def get_site_ros_unit_files():
+    return [f for f in os.environ.get(SITE_ROS_UNIT_FILES_VARIABLE, '').split(os.pathsep) if f]
+
+
+ros_unit_registry = None
+class_and_path2units = {}
+
+
+def get_ros_unit_registry():
+    ''' returns: FrozenDict {class name: FrozenDict {attribute: unit}}
+        '''
+    global ros_unit_registry
+    if ros_unit_registry is None:
+        ros_unit_registry = load_ros_unit_registry([ROS_UNITS_FILE] + get_site_ros_unit_files())
+    return ros_unit_registry
+
+
+def find_attribute_units(class_name, attributes):
+    ''' input: class_name  a class of the registry
+               attributes  tuple, path of the compound variable name, eg: ('msg', 'pose', 'position', 'x')
+        returns: units of the LAST attribute of the path the class knows, or None
+        '''
+    key = (class_name, attributes)
+    if key not in class_and_path2units:
+        attribute2unit = get_ros_unit_registry()[class_name]
+        units = None
+        for p in attributes:
+            if p in attribute2unit:
+                units = attribute2unit[p]
+        class_and_path2units[key] = units
+    return class_and_path2units[key]
@@ -0,0 +1,129 @@
+#!/usr/bin/env python
+# RUN FROM src/:  python -m unittest test_cppcheckdata
+
+import os
+import tempfile
+import unittest
+import cppcheckdata
+
+
+# double f(double x) { return x * 2.0; }   IN TWO CONFIGURATIONS, AFTER THE rawtokens OF NEWER cppcheck
+DUMP = '''<?xml version="1.0"?>
+<dumps>
+  <rawtokens>
+    <file index="0" name="a.cpp"/>
+    <tok fileIndex="0" linenr="1" str="double"/>
+    <tok fileIndex="0" linenr="1" str="f"/>
+  </rawtokens>
+  <dump cfg="">
+    <directivelist>
+      <directive file="a.cpp" linenr="1" str="#include &lt;cmath&gt;"/>
+    </directivelist>
+    <tokenlist>
+      <token id="t1" file="a.cpp" linenr="1" str="double" scope="s1" type="name"/>
+      <token id="t2" file="a.cpp" linenr="1" str="f" scope="s1" type="name" function="f1"/>
+      <token id="t3" file="a.cpp" linenr="1" str="(" scope="s1" link="t6"/>
+      <token id="t4" file="a.cpp" linenr="1" str="double" scope="s1" type="name"/>
+      <token id="t5" file="a.cpp" linenr="1" str="x" scope="s1" type="name" varId="1" variable="v1"/>
+      <token id="t6" file="a.cpp" linenr="1" str=")" scope="s1" link="t3"/>
+      <token id="t7" file="a.cpp" linenr="1" str="{" scope="s2" link="t13"/>
+      <token id="t8" file="a.cpp" linenr="2" str="return" scope="s2" type="name" astOperand1="t10"/>
+      <token id="t9" file="a.cpp" linenr="2" str="x" scope="s2" type="name" varId="1" variable="v1" astParent="t10"/>
+      <token id="t10" file="a.cpp" linenr="2" str="*" scope="s2" type="op" isArithmeticalOp="True" astParent="t8" astOperand1="t9" astOperand2="t11"/>
+      <token id="t11" file="a.cpp" linenr="2" str="2.0" scope="s2" type="number" isFloat="True" values="vf1" astParent="t10"/>
+      <token id="t12" file="a.cpp" linenr="2" str=";" scope="s2"/>
+      <token id="t13" file="a.cpp" linenr="3" str="}" scope="s2" link="t7"/>
+    </tokenlist>
+    <scopes>
+      <scope id="s1" type="Global" classStart="0" classEnd="0" nestedIn="0"/>
+      <scope id="s2" type="Function" className="f" classStart="t7" classEnd="t13" nestedIn="s1" function="f1">
+        <functionList>
+          <function id="f1" tokenDef="t2" name="f">
+            <arg nr="1" variable="v1"/>
+          </function>
+        </functionList>
+      </scope>
+    </scopes>
+    <variables>
+      <var id="v1" nameToken="t5" typeStartToken="t4" typeEndToken="t4" isArgument="true" isArray="false" isClass="false" isLocal="false" isPointer="false" isReference="false" isStatic="false"/>
+    </variables>
+    <valueflow>
+      <values id="vf1">
+        <value intvalue="2"/>
+      </values>
+    </valueflow>
+  </dump>
+  <dump cfg="A">
+    <tokenlist>
+      <token id="u1" file="a.cpp" linenr="1" str="int" scope="r1" type="name"/>
+      <token id="u2" file="a.cpp" linenr="1" str="n" scope="r1" type="name" varId="1" variable="w1"/>
+      <token id="u3" file="a.cpp" linenr="1" str=";" scope="r1"/>
+    </tokenlist>
+    <scopes>
+      <scope id="r1" type="Global" classStart="0" classEnd="0" nestedIn="0"/>
+    </scopes>
+    <variables>
+      <var id="w1" nameToken="u2" typeStartToken="u1" typeEndToken="u1" isArgument="false" isArray="false" isClass="false" isLocal="false" isPointer="false" isReference="false" isStatic="true"/>
+    </variables>
+  </dump>
+</dumps>
+'''
+
+# NOT LOADED BY parsedump_streaming
+SKIPPED_TOKEN_FIELDS = ('valuesId', 'values')
+
+
+def get_field(value):
+    ''' returns: value, WITH A LINKED Token, Scope, Function OR Variable REPLACED BY ITS Id
+        '''
+    if isinstance(value, (cppcheckdata.Token, cppcheckdata.SlotToken, cppcheckdata.Scope,
+                          cppcheckdata.Function, cppcheckdata.Variable)):
+        return ('Id', value.Id)
+    if isinstance(value, dict):
+        return {k: get_field(v) for k, v in value.iteritems()}
+    return value
+
+
+def get_fields(item):
+    if isinstance(item, (cppcheckdata.Token, cppcheckdata.SlotToken)):
+        return {name: get_field(getattr(item, name, None))
+                for name in cppcheckdata.SLOT_TOKEN_FIELDS if name not in SKIPPED_TOKEN_FIELDS}
+    return {name: get_field(value) for name, value in vars(item).iteritems()}
+
+
+class ParseDumpStreamingTest(unittest.TestCase):
+
+    def setUp(self):
+        (fd, self.dump_file) = tempfile.mkstemp(suffix='.dump')
+        with os.fdopen(fd, 'w') as f:
+            f.write(DUMP)
+
+    def tearDown(self):
+        os.remove(self.dump_file)
+
+    def assertConfigurationsEqual(self, streamed, full):
+        self.assertEqual(streamed.name, full.name)
+        for name in ('tokenlist', 'scopes', 'functions', 'variables'):
+            self.assertEqual([get_fields(item) for item in getattr(streamed, name)],
+                             [get_fields(item) for item in getattr(full, name)], name)
+
+    def test_streamed_equals_full(self):
+        full = cppcheckdata.parsedump(self.dump_file)
+        self.assertEqual(len(full.configurations), 2)
+        for i in range(2):
+            streamed = cppcheckdata.parsedump_streaming(self.dump_file, i)
+            self.assertEqual(len(streamed.configurations), 1)
+            self.assertConfigurationsEqual(streamed.configurations[0], full.configurations[i])
+        self.assertEqual(len(full.configurations[0].tokenlist), 13)
+        self.assertEqual(full.configurations[0].functions[0].argument['1'].Id, 'v1')
+        self.assertEqual(cppcheckdata.parsedump_streaming(self.dump_file, 2).configurations, [])
+
+    def test_skipped_sections(self):
+        streamed = cppcheckdata.parsedump_streaming(self.dump_file).configurations[0]
+        self.assertEqual(streamed.directives, [])
+        self.assertEqual(streamed.valueflow, [])
+        self.assertEqual(streamed.tokenlist[10].values, None)
+
+
+if __name__ == '__main__':
+    unittest.main()
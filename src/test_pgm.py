@@ -0,0 +1,133 @@
+#!/usr/bin/env python
+# RUN FROM src/:  python -m unittest test_pgm
+
+import unittest
+from pgm.pgmplayer import PGMPlayer, MultiUnitPGMPlayer
+from pgm.components import ComponentMemo
+
+
+# TWO TRIANGLES SHARING c, EVIDENCE ON a AND e
+EDGES = [('a', 'b'), ('b', 'c'), ('c', 'a'), ('c', 'd'), ('d', 'e'), ('e', 'c')]
+
+
+def make_player(prior_a, same_unit_proba, component_memo=None, should_warm_start=False):
+    player = PGMPlayer()
+    player.bp_backend = 'edge'
+    player.component_memo = component_memo
+    player.should_warm_start_edge_bp = should_warm_start
+    for (left, right) in EDGES:
+        player.add_factor([left], [right], [1, 0, 0, 1], same_unit_proba, 'same unit')
+    player.add_factor(['a'], [], [1, 0], prior_a, 'prior')
+    player.add_factor(['e'], [], [1, 0], 0.7, 'prior')
+    return player
+
+
+def solve(player):
+    ''' returns: {variable name: p0}
+        '''
+    return {pv.name: p0 for pv, p0 in player.compute_marginals().iteritems()}
+
+
+def solve_rounds(same_unit_proba, should_warm_start):
+    ''' ONE SOLVE ROUND PER PRIOR OF a, SHARING ONE ComponentMemo, EACH NEXT TO A COLD SOLVE WITHOUT MEMO
+        returns: [(memo round marginals, cold marginals)], PGMPlayer OF THE LAST ROUND
+        '''
+    component_memo = ComponentMemo()
+    results = []
+    for prior_a in [0.8, 0.6, 0.3]:
+        component_memo.start_round()
+        player = make_player(prior_a, same_unit_proba, component_memo, should_warm_start)
+        results.append((solve(player), solve(make_player(prior_a, same_unit_proba))))
+    return (results, player)
+
+
+class WarmStartTest(unittest.TestCase):
+
+    def assertMarginalsAlmostEqual(self, first, second):
+        self.assertEqual(sorted(first), sorted(second))
+        for name in first:
+            self.assertAlmostEqual(first[name], second[name], places=7)
+
+    def test_changed_component_warm_equals_cold(self):
+        (results, player) = solve_rounds(0.75, True)
+        for (warm, cold) in results:
+            self.assertMarginalsAlmostEqual(warm, cold)
+        # THE LAST ROUND CHANGED THE COMPONENT AND STARTED FROM THE MESSAGES OF THE ROUND BEFORE
+        self.assertEqual(player.component_counts['edge_bp_warm_started'], 1)
+
+    def test_changed_component_starts_cold_by_default(self):
+        # STRONG COUPLING AND CONFLICTING EVIDENCE ON a AND e:  LOOPY BP HAS TWO FIXED POINTS IN THE LAST ROUND,
+        # STARTING FROM THE MESSAGES OF THE ROUND BEFORE CONVERGES TO THE OTHER ONE
+        (results, player) = solve_rounds(0.9, False)
+        for (memo_round, cold) in results:
+            self.assertMarginalsAlmostEqual(memo_round, cold)
+        self.assertEqual(player.component_counts['edge_bp_warm_started'], 0)
+        (results, player) = solve_rounds(0.9, True)
+        (warm, cold) = results[-1]
+        self.assertTrue(abs(warm['a'] - cold['a']) > 0.5)
+
+    def test_unchanged_component_is_reused(self):
+        component_memo = ComponentMemo()
+        component_memo.start_round()
+        first = solve(make_player(0.8, 0.9, component_memo, True))
+        component_memo.start_round()
+        player = make_player(0.8, 0.9, component_memo, True)
+        self.assertEqual(solve(player), first)
+        self.assertEqual(player.component_counts['reused'], 1)
+        self.assertEqual(player.component_counts['edge_bp_warm_started'], 0)
+
+
+# PER UNIT:  PRIOR OF a, PRIOR OF e (None:  NO PRIOR IN THE GRAPH OF THAT UNIT)
+UNIT_PRIORS = [(0.8, 0.7), (0.3, None), (0.6, 0.2)]
+
+
+def solve_units_separately(should_split_components):
+    ''' returns: [{variable name: p0}] OF ONE PGMPlayer PER UNIT
+        '''
+    unit2vname2proba = []
+    for (prior_a, prior_e) in UNIT_PRIORS:
+        player = PGMPlayer()
+        player.bp_backend = 'edge'
+        player.should_split_components = should_split_components
+        for (left, right) in EDGES + [('g', 'h')]:
+            player.add_factor([left], [right], [1, 0, 0, 1], 0.75, 'same unit')
+        player.add_factor(['a'], [], [1, 0], prior_a, 'prior')
+        if prior_e is not None:
+            player.add_factor(['e'], [], [1, 0], prior_e, 'prior')
+        player.add_factor(['g'], [], [1, 0], prior_a, 'prior')
+        unit2vname2proba.append(solve(player))
+    return unit2vname2proba
+
+
+def solve_units_together(should_split_components):
+    player = MultiUnitPGMPlayer(len(UNIT_PRIORS))
+    player.bp_backend = 'edge'
+    player.should_split_components = should_split_components
+    for (left, right) in EDGES + [('g', 'h')]:
+        player.add_unit_factor([left], [right], [1, 0, 0, 1], 0.75, 'same unit')
+    player.add_unit_factor(['a'], [], [1, 0], [prior_a for (prior_a, prior_e) in UNIT_PRIORS], 'prior')
+    player.add_unit_factor(['e'], [], [1, 0], [prior_e for (prior_a, prior_e) in UNIT_PRIORS], 'prior')
+    player.add_unit_factor(['g'], [], [1, 0], [prior_a for (prior_a, prior_e) in UNIT_PRIORS], 'prior')
+    return player.compute_marginals_by_unit()
+
+
+class MultiUnitTest(unittest.TestCase):
+
+    def assertUnitMarginalsAlmostEqual(self, first, second, places):
+        self.assertEqual(len(first), len(second))
+        for (vname2proba, other) in zip(first, second):
+            self.assertEqual(sorted(vname2proba), sorted(other))
+            for vname in vname2proba:
+                self.assertAlmostEqual(vname2proba[vname], other[vname], places=places)
+
+    def test_units_together_equal_units_separately(self):
+        # PER UNIT A LOOPY COMPONENT AND A TREE (g, h)
+        self.assertUnitMarginalsAlmostEqual(solve_units_together(True), solve_units_separately(True), 12)
+
+    def test_joint_tolerance(self):
+        # ONE BP RUN OVER ALL THE COPIES
+        self.assertUnitMarginalsAlmostEqual(solve_units_together(False), solve_units_separately(False), 7)
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,105 @@
+#!/usr/bin/env python
+# RUN FROM src/:  python -m unittest test_phys_unit
+
+import unittest
+import phys_unit
+import cps_constraints as con
+from ros_unit_registry import find_attribute_units
+from tree_walker import TreeWalker
+
+
+class UnitToken(object):
+    ''' THE FIELDS OF A cppcheck Token READ BY THE UNIT MERGES
+        '''
+
+    def __init__(self, units):
+        self.units = units
+        self.isKnown = False
+        self.variable = None
+        self.is_unit_propagation_based_on_weak_inference = False
+        self.is_unit_propagation_based_on_constants = False
+        self.is_unit_propagation_based_on_unknown_variable = False
+
+
+def get_wrench_units():
+    # A NESTED ROS MESSAGE UNIT, {attribute: unit}, AS APPENDED TO token.units BY apply_ROS_units
+    return find_attribute_units('sensor_msgs::MultiDOFJointState', ('msg', 'wrench'))
+
+
+class NestedUnitTest(unittest.TestCase):
+
+    def setUp(self):
+        self.tw = TreeWalker(None)
+        self.wrench = get_wrench_units()
+
+    def test_nested_unit_is_interned(self):
+        unit = phys_unit.make_unit(self.wrench)
+        self.assertEqual(unit, self.wrench)
+        self.assertTrue(phys_unit.make_unit(dict(self.wrench)) is unit)
+        vocabulary = phys_unit.UnitVocabulary()
+        self.assertTrue(vocabulary.unit_bit(self.wrench) & vocabulary.units_mask([unit]))
+
+    def test_vocabulary(self):
+        vocabulary = phys_unit.UnitVocabulary()
+        self.assertEqual(vocabulary.units_mask([self.wrench, phys_unit.RADIAN]), 3)
+        # A LIST UNIT, NESTED LISTS INCLUDED, HAS ITS OWN BIT
+        nested = [phys_unit.RADIAN, [dict(self.wrench), phys_unit.PER_SECOND]]
+        self.assertEqual(vocabulary.unit_bit(nested), 4)
+        self.assertEqual(vocabulary.unit_bit([phys_unit.RADIAN, [self.wrench, {'second': -1.0}]]), 4)
+        self.assertEqual(vocabulary.units_mask([phys_unit.RADIAN, nested]), 6)
+        # BITS ARE PER STORE, ONE ANALYSIS DOES NOT GROW THE MASKS OF ANOTHER
+        self.assertEqual(con.ConstraintStore().unit_vocabulary.unit_bit(phys_unit.PER_SECOND), 1)
+        new_units = self.tw.merge_units_by_set_union([nested], [phys_unit.RADIAN, nested])
+        self.assertEqual(new_units, [nested, phys_unit.RADIAN])
+
+    def test_union(self):
+        new_units = self.tw.merge_units_by_set_union([phys_unit.RADIAN, self.wrench], [self.wrench, phys_unit.PER_SECOND])
+        self.assertEqual(new_units, [phys_unit.RADIAN, self.wrench, phys_unit.PER_SECOND])
+
+    def test_intersection(self):
+        new_units = self.tw.merge_units_by_set_intersection([phys_unit.RADIAN, self.wrench], [self.wrench])
+        self.assertEqual(new_units, [self.wrench])
+        self.assertEqual(self.tw.merge_units_by_set_intersection([phys_unit.RADIAN], [self.wrench]), [])
+
+    def test_update(self):
+        to_token = UnitToken([phys_unit.RADIAN])
+        self.assertTrue(self.tw.update_units_from_to(UnitToken([self.wrench]), to_token))
+        self.assertFalse(self.tw.update_units_from_to(UnitToken([self.wrench]), to_token))
+        self.assertEqual(to_token.units, [phys_unit.RADIAN, self.wrench])
+
+    def test_units_key(self):
+        self.assertEqual(con.get_units_key([self.wrench, [phys_unit.RADIAN, dict(self.wrench)]]),
+                         (phys_unit.make_unit(self.wrench), (phys_unit.RADIAN, phys_unit.make_unit(self.wrench))))
+
+    def test_track_unit(self):
+        store = con.ConstraintStore()
+        store.track_unit(self.wrench)
+        store.track_unit(dict(self.wrench))
+        store.track_unit([self.wrench, phys_unit.RADIAN])
+        self.assertEqual(store.units, [self.wrench, [self.wrench, phys_unit.RADIAN]])
+
+    def test_cf_constraint(self):
+        store = con.ConstraintStore()
+        token = UnitToken([])
+        store.add_cf_constraint(token, 'w', [self.wrench], con.CF_1)
+        store.is_repeat_round = True
+        store.add_cf_constraint(token, 'w', [dict(self.wrench)], con.CF_1)
+        self.assertEqual(len(store.conversion_factor_constraints), 1)
+        self.assertEqual(store.units, [self.wrench])
+
+    def test_arithmetic(self):
+        meter = phys_unit.make_unit({'meter': 1.0})
+        self.assertEqual(phys_unit.multiply(self.wrench, meter), dict(self.wrench, meter=1.0))
+        self.assertEqual(phys_unit.divide(meter, self.wrench), dict(self.wrench, meter=1.0))
+        self.assertEqual(phys_unit.multiply(self.wrench, self.wrench), self.wrench)
+        self.assertEqual(phys_unit.power(dict(self.wrench, second=-1.0), 2), dict(self.wrench, second=-2.0))
+        self.assertEqual(phys_unit.sqrt(self.wrench), self.wrench)
+        self.assertEqual(phys_unit.multiply(None, meter), meter)
+        self.assertEqual(phys_unit.inverse(None), {})
+        # FLAT UNITS ARE UNCHANGED
+        self.assertTrue(phys_unit.divide(phys_unit.DEGREE_360_PER_SECOND, phys_unit.PER_SECOND) is phys_unit.DEGREE_360)
+        self.assertTrue(phys_unit.multiply(phys_unit.PER_SECOND, {'second': 1.0}) is phys_unit.make_unit({}))
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,84 @@
+#!/usr/bin/env python
+# RUN FROM src/:  python -m unittest test_prob_phys_units
+
+import unittest
+import phys_unit
+import cps_constraints as con
+from prob_phys_units import solve_until_stable
+
+
+class VariableToken(object):
+    ''' THE FIELDS OF A cppcheck Token READ BY THE ConstraintStore
+        '''
+
+    def __init__(self, Id, variable):
+        self.Id = Id
+        self.variable = variable
+
+
+class RoundCollector(object):
+    ''' STANDS IN FOR A ConstraintCollector:  EVERY COLLECTION ADDS THE SAME ks AND cf CONSTRAINTS AGAIN,
+        LIKE repeat_collect_constraints DOES, PLUS THE NEW ks CONSTRAINTS GIVEN FOR THAT ROUND
+        '''
+
+    def __init__(self, new_ks_by_round=None):
+        self.con = con.ConstraintStore()
+        self.new_ks_by_round = new_ks_by_round or {}
+        self.rounds = []
+        self.speed = VariableToken('t1', 'speed')
+        self.angle = VariableToken('t2', 'angle')
+        self.collect(1)
+
+    def collect(self, i):
+        self.rounds.append(i)
+        self.con.add_ks_constraint(self.speed, 'speed', [phys_unit.PER_SECOND])
+        self.con.add_cf_constraint(self.angle, 'angle', [phys_unit.RADIAN], con.CF_3)
+        for (token, units) in self.new_ks_by_round.get(i, []):
+            self.con.add_ks_constraint(token, token.variable, units)
+
+    def repeat_run_collect(self, i):
+        if (i > 2):
+            self.con.is_repeat_round = True
+        self.con.reset_constraints()
+        self.collect(i)
+
+
+class DistinctConstraintSolver(object):
+    ''' STANDS IN FOR A ConstraintSolver:  THE BEST UNIT OF A VARIABLE IS ITS FIRST ks UNIT
+        '''
+
+    def __init__(self, store):
+        self.con = store
+        self.compaction_counts = dict.fromkeys(['factors_in', 'factors_out', 'merged', 'constant',
+                                                'vars_in', 'vars_out'], 0)
+
+    def solve(self):
+        var2unitproba = {}
+        for ks_con in self.con.known_symbol_constraints.values():
+            (token, name, units) = ks_con[0]
+            var2unitproba[(token.variable, name)] = [(units[0], 0.95)]
+        return var2unitproba
+
+
+class SolveRoundsTest(unittest.TestCase):
+
+    def test_repeated_constraints_stop_after_two_rounds(self):
+        collector = RoundCollector()
+        (var2unitproba, nr_rounds) = solve_until_stable(collector, DistinctConstraintSolver(collector.con))
+        self.assertEqual(nr_rounds, 2)
+        self.assertEqual(collector.rounds, [1, 2])
+        # ROUND 2 STILL APPENDED ITS COPIES, THEY DO NOT COUNT AS NEW CONSTRAINTS
+        self.assertEqual(len(collector.con.known_symbol_constraints.values()[0]), 2)
+        self.assertEqual(len(collector.con.conversion_factor_constraints), 2)
+        self.assertEqual(var2unitproba, {('speed', 'speed'): [(phys_unit.PER_SECOND, 0.95)]})
+
+    def test_new_constraint_runs_another_round(self):
+        accel = VariableToken('t3', 'accel')
+        collector = RoundCollector({2: [(accel, [phys_unit.make_unit({'meter': 1.0, 'second': -2.0})])]})
+        (var2unitproba, nr_rounds) = solve_until_stable(collector, DistinctConstraintSolver(collector.con))
+        self.assertEqual(nr_rounds, 3)
+        self.assertEqual(collector.rounds, [1, 2, 3])
+
+
+if __name__ == '__main__':
+    unittest.main()
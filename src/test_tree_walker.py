@@ -0,0 +1,166 @@
+#!/usr/bin/env python
+# RUN FROM src/:  python -m unittest test_tree_walker
+
+import random
+import unittest
+import phys_unit
+from constraint_collector import ConstraintCollector
+from tree_walker import TreeWalker
+
+
+class AstToken(object):
+    ''' THE FIELDS OF A cppcheck Token READ BY THE PROPAGATION RULES
+        '''
+
+    def __init__(self, s, left=None, right=None, units=None, isOp=False, isNumber=False):
+        self.str = s
+        self.astOperand1 = left
+        self.astOperand2 = right
+        self.astParent = None
+        self.units = units or []
+        self.isKnown = bool(self.units)
+        self.isOp = isOp
+        self.isNumber = isNumber
+        self.isName = not (isOp or isNumber)
+        self.isDimensionless = False
+        self.isRoot = False
+        self.function = None
+        self.variable = None
+        self.scope = None
+        self.linenr = '1'
+        self.is_unit_propagation_based_on_constants = False
+        self.is_unit_propagation_based_on_unknown_variable = False
+        self.is_unit_propagation_based_on_weak_inference = False
+        for operand in (left, right):
+            if operand is not None:
+                operand.astParent = self
+
+
+class FunctionStub(object):
+    ''' THE FIELDS OF A cppcheck Function READ AND WRITTEN BY THE PROPAGATION RULES
+        '''
+
+    def __init__(self, nr_args, return_arg_var_nr):
+        self.arg_units = [[] for i in range(nr_args)]
+        self.return_arg_var_nr = return_arg_var_nr
+        self.return_expr_root_token = None
+        self.maybe_generic_function = False
+
+
+UNITS = [{'meter': 1.0}, {'second': -1.0}, {'second': 1.0}, {'meter': 1.0, 'second': -1.0}, {'radian': 1.0}]
+
+
+def make_leaf(rng):
+    k = rng.random()
+    if k < 0.2:
+        return AstToken(str(rng.randint(1, 9)), isNumber=True)
+    units = [phys_unit.make_unit(rng.choice(UNITS)) for i in range(rng.randint(0, 2))] if k < 0.8 else []
+    return AstToken(rng.choice('abcdefgh'), units=units)
+
+
+def make_expression(rng, depth, function):
+    ''' A RANDOM EXPRESSION OVER THE TOKENS THE PROPAGATION RULES ACT ON.  CALLS OF function, WHICH 
+        RETURNS THE UNITS OF ITS FIRST ARGUMENT, LINK THE CALLS OF ONE STATEMENT THROUGH ITS arg_units
+        '''
+    if depth == 0 or rng.random() < 0.25:
+        return make_leaf(rng)
+    k = rng.randint(0, 7)
+    if k <= 2:
+        return AstToken(rng.choice(['+', '-', '*', '/']),
+                        make_expression(rng, depth - 1, function), make_expression(rng, depth - 1, function), isOp=True)
+    if k == 3:
+        return AstToken('?', make_expression(rng, depth - 1, function),
+                        AstToken(':', make_expression(rng, depth - 1, function), make_expression(rng, depth - 1, function)))
+    if k == 4:
+        return AstToken('(', AstToken(rng.choice(['sqrt', 'fabs', 'floor'])), make_expression(rng, depth - 1, function))
+    if k == 5:
+        return AstToken('(', AstToken(rng.choice(['fmod', 'atan2', 'min', 'pow'])),
+                        AstToken(',', make_expression(rng, depth - 1, function), make_expression(rng, depth - 1, function)))
+    if k == 6:
+        name_token = AstToken('foo')
+        name_token.function = function
+        return AstToken('(', name_token,
+                        AstToken(',', make_expression(rng, depth - 1, function), make_expression(rng, depth - 1, function)))
+    return AstToken('[', make_leaf(rng), make_expression(rng, depth - 1, function))
+
+
+def make_statement(seed):
+    rng = random.Random(seed)
+    return AstToken('=', make_leaf(rng), make_expression(rng, 5, FunctionStub(2, 1)), isOp=True)
+
+
+def make_nested_calls(depth):
+    ''' x = fabs(fabs(...fabs(a)...)):  THE PER-RULE WALKS MOVE THE UNITS OF a ONE CALL UP PER ROUND
+        '''
+    expression = AstToken('a', units=[phys_unit.make_unit({'meter': 1.0})])
+    for i in range(depth):
+        expression = AstToken('(', AstToken('fabs'), expression)
+    return AstToken('=', AstToken('x'), expression, isOp=True)
+
+
+def get_tokens(root_token):
+    tokens = []
+    TreeWalker(None).generic_recurse_and_apply_function(root_token, lambda t, l, r: tokens.append(t))
+    return tokens
+
+
+def make_walker(mode):
+    ''' input: mode  'walk' (ONE WALK PER RULE), 'by_rule' (FUSED PLAN) OR 'worklist'
+        returns: TreeWalker AS LEFT BY THE PASSES THAT APPLY THE INITIAL UNITS
+        '''
+    tw = TreeWalker(None)
+    tw.should_fuse_propagation_walks = (mode != 'walk')
+    tw.should_use_propagation_worklist = (mode == 'worklist')
+    tw.was_some_unit_changed = True
+    tw.found_units_in_this_tree = True
+    return tw
+
+
+def propagate(root_token, mode, intersection_rules=()):
+    ''' RUN THE PROPAGATION RULES TO A FIXPOINT, WITH THE STOPPING RULE OF THE COLLECTOR
+        returns: units and isKnown of every token, in post-order
+        '''
+    tw = make_walker(mode)
+    for i in range(100):
+        if not tw.was_some_unit_changed:
+            break
+        tw.was_some_unit_changed = False
+        tw.propagate_units_one_round(root_token, intersection_rules=intersection_rules)
+    return [(t.str, t.units, t.isKnown) for t in get_tokens(root_token)]
+
+
+class PropagationModesTest(unittest.TestCase):
+
+    INTERSECTION_RULES = ('propagate_units_across_operators', 'propagate_units_ternary',
+                          'propagate_units_math_fmod_fmodf_fmodl', 'propagate_units_math_min_max')
+
+    def test_worklist_reaches_the_result_of_the_per_rule_walks(self):
+        for seed in range(300):
+            for intersection_rules in [(), self.INTERSECTION_RULES]:
+                walked = propagate(make_statement(seed), 'walk', intersection_rules)
+                self.assertEqual(walked, propagate(make_statement(seed), 'by_rule', intersection_rules), seed)
+                self.assertEqual(walked, propagate(make_statement(seed), 'worklist', intersection_rules), seed)
+
+    def test_long_function_stays_under_break_point(self):
+        # 40 STATEMENTS OF 30 NESTED CALLS:  THE PER-RULE WALKS NEED 32 ROUNDS EACH, 1280 IN ALL, WHICH
+        # EXCEEDED break_point = 1000 WHEN IT COUNTED THE ROUNDS OF THE WHOLE FUNCTION
+        collector = ConstraintCollector(None)
+        rounds = [collector.propagate_units_until_stable(make_walker('by_rule'), make_nested_calls(30))
+                  for i in range(40)]
+        self.assertTrue(sum(rounds) > 1000)
+        # ONE CALL OF THE WORKLIST RUNS ALL THE ROUNDS OF AN AST
+        for i in range(40):
+            root_token = make_nested_calls(30)
+            self.assertEqual(collector.propagate_units_until_stable(make_walker('worklist'), root_token), 1)
+            self.assertEqual(root_token.units, [{'meter': 1.0}])
+        self.assertEqual(propagate(make_nested_calls(30), 'by_rule'), propagate(make_nested_calls(30), 'worklist'))
+
+    def test_break_point_bounds_the_rounds_of_one_ast(self):
+        collector = ConstraintCollector(None)
+        self.assertRaises(ValueError, collector.propagate_units_until_stable,
+                          make_walker('by_rule'), make_nested_calls(30), 10)
+        self.assertEqual(collector.propagate_units_until_stable(make_walker('by_rule'), make_nested_calls(30), 40), 32)
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,149 @@
+#!/usr/bin/env python
+
+from array import array
+
+
+# STRUCT-OF-ARRAYS VIEW OF THE TOKEN LIST OF A PARSED cppcheck Configuration.
+# A TOKEN IS ITS INDEX IN tokenlist, EVERY LINK (AST PARENT / OPERANDS, '(' <-> ')' LINK) IS AN INDEX, -1 IS None.
+# THE TOKEN OBJECTS STAY THE ONES THE TREE WALKER DECORATES;  PASSES THAT ONLY NEED THE STRUCTURE OF
+# THE AST RUN OVER THE ARRAYS AND MAP THEIR RESULT BACK WITH tokens[i]
+# (ConstraintCollector.find_root_tokens, TreeWalker.get_rules_in_postorder)
+
+NO_TOKEN = -1
+
+# BIT OF EACH cppcheck FLAG IN TokenTable.flags
+TOKEN_FLAGS = ('isName', 'isNumber', 'isInt', 'isFloat', 'isString', 'isChar', 'isOp',
+               'isArithmeticalOp', 'isAssignmentOp', 'isComparisonOp', 'isLogicalOp')
+FLAG_BITS = dict((name, 1 << i) for (i, name) in enumerate(TOKEN_FLAGS))
+# BIT SET WHEN token.function IS NOT None
+FUNCTION_FLAG = 1 << len(TOKEN_FLAGS)
+
+
+class TokenTable:
+    ''' PARALLEL int32 ARRAYS, ONE ENTRY PER TOKEN:
+            str_id        INDEX INTO strings
+            flags         OR OF FLAG_BITS (AND FUNCTION_FLAG)
+            linenr, var_id  (var_id 0 WHEN THE TOKEN IS NOT A VARIABLE)
+            ast_parent, ast_operand1, ast_operand2, link   TOKEN INDICES
+        '''
+
+    def __init__(self, cppcheck_configuration):
+        self.tokens = list(cppcheck_configuration.tokenlist)
+        self.strings = []
+        self.str_id = array('i')
+        self.flags = array('i')
+        self.linenr = array('i')
+        self.var_id = array('i')
+        self.ast_parent = array('i')
+        self.ast_operand1 = array('i')
+        self.ast_operand2 = array('i')
+        self.link = array('i')
+        self.id2index = {}
+        self.roots = None
+
+        string2id = {}
+        for (i, t) in enumerate(self.tokens):
+            self.id2index[t.Id] = i
+        for t in self.tokens:
+            if t.str not in string2id:
+                string2id[t.str] = len(self.strings)
+                self.strings.append(t.str)
+            self.str_id.append(string2id[t.str])
+            bits = 0
+            for name in TOKEN_FLAGS:
+                if getattr(t, name, False):
+                    bits |= FLAG_BITS[name]
+            if t.function is not None:
+                bits |= FUNCTION_FLAG
+            self.flags.append(bits)
+            self.linenr.append(int(t.linenr or 0))
+            self.var_id.append(int(t.varId or 0))
+            self.ast_parent.append(self.index_of(t.astParent))
+            self.ast_operand1.append(self.index_of(t.astOperand1))
+            self.ast_operand2.append(self.index_of(t.astOperand2))
+            self.link.append(self.index_of(t.link))
+
+
+    def __len__(self):
+        return len(self.tokens)
+
+
+    def index_of(self, token):
+        if token is None:
+            return NO_TOKEN
+        return self.id2index[token.Id]
+
+
+    def get_str(self, i):
+        return self.strings[self.str_id[i]]
+
+
+    def has_flag(self, i, name):
+        return bool(self.flags[i] & FLAG_BITS[name])
+
+
+    def get_roots(self):
+        ''' ROOT OF THE AST OF EVERY TOKEN, ONE PASS WITH PATH COMPRESSION
+            returns: array, roots[i] == i FOR A TOKEN WITHOUT astParent
+            '''
+        if self.roots is not None:
+            return self.roots
+        parent = self.ast_parent
+        roots = array('i', [NO_TOKEN]) * len(parent)
+        for i in xrange(len(parent)):
+            if roots[i] != NO_TOKEN:
+                continue
+            path = []
+            j = i
+            while roots[j] == NO_TOKEN and parent[j] != NO_TOKEN:
+                path.append(j)
+                j = parent[j]
+            root = roots[j] if roots[j] != NO_TOKEN else j
+            roots[j] = root
+            for k in path:
+                roots[k] = root
+        self.roots = roots
+        return roots
+
+
+    def find_roots(self, start, end):
+        ''' ROOTS OF THE ASTS THAT CONTAIN A TOKEN OF [start, end) WITH AN astParent
+            input: start, end  token indices
+            returns: list of token indices, sorted by line number (then by position)
+            '''
+        parent = self.ast_parent
+        roots = self.get_roots()
+        found = set()
+        for i in xrange(start, end):
+            if parent[i] != NO_TOKEN:
+                found.add(roots[i])
+        return sorted(found, key=lambda r: (self.linenr[r], r))
+
+
+    def postorder(self, root):
+        ''' returns: token indices of the AST under root, operand1 subtree, operand2 subtree, then the token
+            (THE ORDER OF TreeWalker.generic_recurse_and_apply_function)
+            '''
+        order = []
+        stack = [(root, False)]
+        while stack:
+            (i, is_expanded) = stack.pop()
+            if i == NO_TOKEN:
+                continue
+            if is_expanded:
+                order.append(i)
+                continue
+            stack.append((i, True))
+            stack.append((self.ast_operand2[i], False))
+            stack.append((self.ast_operand1[i], False))
+        return order
+
+
+def get_token_table(cppcheck_configuration):
+    ''' returns: TokenTable of the Configuration, BUILT ONCE
+        '''
+    table = getattr(cppcheck_configuration, 'token_table', None)
+    if table is None:
+        table = TokenTable(cppcheck_configuration)
+        cppcheck_configuration.token_table = table
+    return table
@@ -1,6 +1,8 @@
 from symbol_helper import SymbolHelper
 import cps_constraints as con
-import copy
+import phys_unit
+from token_table import FUNCTION_FLAG
+import heapq
 from operator import itemgetter
 
 
@@ -8,10 +10,34 @@ class TreeWalker:
 
     name = None
 
-    def __init__(self, my_type_miner, my_vnh=None):
+    # PROPAGATION RULES IN THE ORDER THEY ARE APPLIED DURING ONE ROUND, EACH WITH THE token.str 
+    # VALUES IT ACTS ON  (None:  ANY TOKEN WITH A token.function)
+    PROPAGATION_RULES = [
+            ('propagate_units_across_dot_connectors', ['.']),
+            ('propagate_units_across_double_colon', ['::']),
+            ('propagate_units_across_square_brackets', ['[']),
+            ('propagate_units_across_assignment', ['=']),
+            ('propagate_units_math_abs_fabs_floor_ceil', ['abs', 'fabs', 'floor', 'ceil']),
+            ('propagate_units_math_min_max', ['min', 'max']),
+            ('propagate_units_math_fmod_fmodf_fmodl', ['fmod', 'fmodf', 'fmodl']),
+            ('propagate_units_sqrt', ['sqrt']),
+            ('propagate_units_ternary', ['?']),
+            ('propagate_units_pow', ['pow']),
+            ('propagate_units_inverse_trig', ['atan2', 'acos', 'asin', 'atan']),
+            ('propagate_units_across_operators', ['+', '-', '+=', '-=', '*', '/', '*=', '/=']),
+            ('propagate_units_across_return', ['return']),
+            ('collect_function_param_units_and_decorate_function', None),
+            ('propagate_units_across_parenthesis', ['(']),
+            ]
+
+    # WORKLIST PROPAGATION GIVES UP (ValueError) AFTER THIS MANY RULE EVALUATIONS PER AST TOKEN
+    WORKLIST_EVALUATIONS_PER_TOKEN_LIMIT = 1000
+
+    def __init__(self, my_type_miner, my_vnh=None, constraint_store=None):
         self.type_miner = my_type_miner
         self.vnh = my_vnh
-        self.my_symbol_helper = SymbolHelper()
+        self.con = constraint_store if constraint_store is not None else con.ConstraintStore()
+        self.my_symbol_helper = SymbolHelper(self.con)
         self.symbol_helper = self.my_symbol_helper
         self.source_file = ''
         self.source_file_lines = []
@@ -36,6 +62,13 @@ class TreeWalker:
         self.found_non_known_unit_variable_in_rhs = False
         self.found_known_unit_variable_in_rhs = False
         self.found_non_ros_unit_variable_in_rhs = False
+        self.should_fuse_propagation_walks = True   # False: ONE FULL AST WALK PER PROPAGATION RULE
+        self.should_use_propagation_worklist = True  # ONLY REVISIT TOKENS WHOSE INPUTS CHANGED (FUSED ONLY)
+        self.propagation_rule_tables = {}
+        self.token_table = None  # TokenTable OF THE CONFIGURATION:  PLANS ARE BUILT OVER ITS COLUMNS
+        self.str_id_rule_tables = {}
+        self.fused_walk_plans = {}
+        self.worklist_plans = {}
 
 
     def generic_recurse_and_apply_function(self, token, function_to_apply):
@@ -64,6 +97,329 @@ class TreeWalker:
         function_to_apply(token, left_token, right_token)
 
 
+    def propagate_units_one_round(self, root_token, skipped_rules=(), intersection_rules=()):
+        ''' APPLY EVERY PROPAGATION RULE (PROPAGATION_RULES) ONCE OVER AN AST
+            input:  root_token  CPPCHECK token to recurse upon
+                    skipped_rules  names of rules not to apply
+                    intersection_rules  names of rules applied with self.perform_intersection
+            returns: None   side effect: units on tokens, self.was_some_unit_changed
+            '''
+        if self.should_fuse_propagation_walks:
+            rule_table = self.get_propagation_rule_table(tuple(skipped_rules), tuple(intersection_rules))
+            if self.should_use_propagation_worklist:
+                self.propagate_units_by_worklist(root_token, rule_table)
+            else:
+                self.apply_propagation_rules_by_rule(root_token, rule_table)
+            return
+        for (rule_name, trigger_strs) in self.PROPAGATION_RULES:
+            if rule_name in skipped_rules:
+                continue
+            self.perform_intersection = (rule_name in intersection_rules)
+            rule = getattr(self, rule_name)
+            self.generic_recurse_and_apply_function(root_token, 
+                                                    lambda t, l, r: self.apply_propagation_rule(rule, t, l, r))
+            self.perform_intersection = False
+
+
+    def apply_propagation_rule(self, rule, token, left_token, right_token):
+        ''' APPLY ONE PROPAGATION RULE TO ONE TOKEN.  A RULE SETS perform_union_when_empty RIGHT BEFORE 
+            ITS OWN MERGE, DON'T LET IT LEAK INTO THE NEXT RULE APPLICATION (THE OUTCOME OF A RULE WOULD 
+            DEPEND ON WHICH RULE RAN BEFORE IT)
+            '''
+        self.perform_union_when_empty = False
+        rule(token, left_token, right_token)
+
+
+    def get_propagation_rule_table(self, skipped_rules, intersection_rules):
+        ''' DISPATCH TABLE FOR THE FUSED WALK
+            returns: tuple (dict token.str -> [(rule index, rule, perform_intersection)], 
+                            [(rule index, rule, perform_intersection)] for tokens with a token.function)
+            '''
+        key = (skipped_rules, intersection_rules)
+        if key not in self.propagation_rule_tables:
+            str2rules = {}
+            function_rules = []
+            for (i, (rule_name, trigger_strs)) in enumerate(self.PROPAGATION_RULES):
+                if rule_name in skipped_rules:
+                    continue
+                rule = (i, getattr(self, rule_name), rule_name in intersection_rules)
+                if trigger_strs is None:
+                    function_rules.append(rule)
+                    continue
+                for trigger_str in trigger_strs:
+                    str2rules.setdefault(trigger_str, []).append(rule)
+            self.propagation_rule_tables[key] = (str2rules, function_rules)
+        return self.propagation_rule_tables[key]
+
+
+    def apply_propagation_rules_by_rule(self, root_token, rule_table):
+        ''' APPLY THE PROPAGATION RULES IN PROPAGATION_RULES ORDER, EACH OVER THE AST TOKENS IN POST-ORDER, 
+            LIKE ONE generic_recurse_and_apply_function WALK PER RULE.  BUT THE AST IS ONLY WALKED ONCE, 
+            WHEN ITS PLAN IS BUILT, AND EACH RULE ONLY VISITS THE TOKENS IT CAN ACT ON.
+            '''
+        for (rule, perform_intersection, tokens) in self.get_fused_walk_plan(root_token, rule_table):
+            self.perform_intersection = perform_intersection
+            for token in tokens:
+                self.apply_propagation_rule(rule, token, token.astOperand1, token.astOperand2)
+        self.perform_intersection = False
+
+
+    def get_fused_walk_plan(self, root_token, rule_table):
+        ''' returns: list of (rule, perform_intersection, AST tokens it acts on in post-order), 
+                     in PROPAGATION_RULES order
+            '''
+        key = (id(root_token), id(rule_table))
+        if key not in self.fused_walk_plans:
+            (tokens, rules_at) = self.get_rules_in_postorder(root_token, rule_table)
+            index2plan = {}
+            for (t, rules) in zip(tokens, rules_at):
+                for (i, rule, perform_intersection) in rules:
+                    index2plan.setdefault(i, (rule, perform_intersection, []))[2].append(t)
+            self.fused_walk_plans[key] = [index2plan[i] for i in sorted(index2plan)]
+        return self.fused_walk_plans[key]
+
+
+    def get_rules_for_token(self, token, rule_table):
+        (str2rules, function_rules) = rule_table
+        rules = str2rules.get(token.str)
+        if token.function and function_rules:
+            rules = sorted((rules or []) + function_rules)
+        return rules
+
+
+    def get_rules_in_postorder(self, root_token, rule_table):
+        ''' AST TOKENS UNDER root_token IN POST-ORDER, EACH WITH THE RULES OF rule_table THAT ACT ON IT.
+            WITH A token_table, THE WALK RUNS OVER ITS OPERAND COLUMNS AND THE DISPATCH OVER ITS 
+            str_id AND flags COLUMNS;  ASTS THAT ARE NOT IN IT ARE WALKED TOKEN BY TOKEN
+            returns: tuple (tokens, list of rules at each token)
+            '''
+        table = self.token_table
+        if table is None or getattr(root_token, 'Id', None) not in table.id2index:
+            tokens = []
+            self.generic_recurse_and_apply_function(root_token, lambda t, l, r: tokens.append(t))
+            return (tokens, [self.get_rules_for_token(t, rule_table) or [] for t in tokens])
+
+        (str_id2rules, function_rules) = self.get_str_id_rule_table(table, rule_table)
+        order = table.postorder(table.id2index[root_token.Id])
+        str_id = table.str_id
+        flags = table.flags
+        rules_at = []
+        for i in order:
+            rules = str_id2rules[str_id[i]]
+            if function_rules and flags[i] & FUNCTION_FLAG:
+                rules = sorted(rules + function_rules)
+            rules_at.append(rules)
+        return ([table.tokens[i] for i in order], rules_at)
+
+
+    def get_str_id_rule_table(self, table, rule_table):
+        ''' returns: tuple (list str_id -> rules, rules for tokens with a token.function)
+            '''
+        key = (id(table), id(rule_table))
+        if key not in self.str_id_rule_tables:
+            (str2rules, function_rules) = rule_table
+            self.str_id_rule_tables[key] = ([str2rules.get(s, []) for s in table.strings], function_rules)
+        return self.str_id_rule_tables[key]
+
+
+    def propagate_units_by_worklist(self, root_token, rule_table):
+        ''' SAME RULES, IN THE SAME ORDER, AS apply_propagation_rules_by_rule, BUT AFTER ITS FIRST 
+            EVALUATION A RULE IS ONLY RE-EVALUATED AT A TOKEN WHEN SOMETHING IT READS HAS CHANGED.
+            WORK ITEMS ARE (RULE INDEX, POST-ORDER POSITION) AND ARE TAKEN IN PASSES:  AN ITEM 
+            ENQUEUED AFTER THE CURRENT ONE RUNS IN THIS PASS, ANY OTHER IN THE NEXT PASS, LIKE THE 
+            NEXT ROUND OF THE PER-RULE WALKS.
+            WHEN THE UNITS (OR PROPAGATION STATUS) OF A TOKEN CHANGE, THE TOKEN, ITS astParent AND THE 
+            TOKENS REGISTERED AS ITS READERS ARE RE-ENQUEUED.  WHEN THE STATE OF A FUNCTION CHANGES 
+            (ARG UNITS, RETURN ARG), THE TOKENS OF THIS AST THAT READ THAT FUNCTION ARE RE-ENQUEUED.
+            ONE CALL RUNS ALL THE ROUNDS THE CALLER'S LOOP WOULD RUN:  LIKE THAT LOOP, IT STOPS AFTER THE 
+            FIRST PASS THAT CHANGED NO UNITS, EVEN IF THAT PASS CHANGED A PROPAGATION STATUS (isKnown...)
+            side effect: self.was_some_unit_changed IS LEFT False, THE CALLER'S LOOP IS DONE
+            '''
+        plan = self.get_worklist_plan(root_token, rule_table)
+        (tokens, rules_at, watched_at, functions_at, parent_at, readers_of, function_readers, argument_of) = plan
+        limit = self.WORKLIST_EVALUATIONS_PER_TOKEN_LIMIT * len(tokens)
+        snapshot = self.take_propagation_snapshot
+        function_snapshot = self.take_function_snapshot
+
+        heap = []
+        for i in range(len(tokens)):
+            for rule in rules_at[i]:
+                heap.append((rule[0], i, rule))
+        heapq.heapify(heap)
+        next_heap = []
+        queued = set((rule_index, i) for (rule_index, i, rule) in heap)
+
+        pass_unit_changed = False
+        evaluations = 0
+        while heap or next_heap:
+            if not heap:
+                # END OF A PASS.  THE PER-RULE WALKS STOP AFTER A ROUND THAT CHANGED NO UNITS
+                if not pass_unit_changed:
+                    break
+                (heap, next_heap) = (next_heap, [])
+                pass_unit_changed = False
+            current = heapq.heappop(heap)
+            (i, (rule_index, rule, perform_intersection)) = current[1:]
+            queued.discard((rule_index, i))
+            evaluations += 1
+            if evaluations > limit:
+                s = "BREAKING WORKLIST AT %d EVALUATIONS" % evaluations
+                raise ValueError(s)
+
+            token = tokens[i]
+            before = [snapshot(tokens[w]) for w in watched_at[i]]
+            functions_before = [function_snapshot(f) for f in functions_at[i]]
+
+            self.was_some_unit_changed = False
+            self.perform_intersection = perform_intersection
+            self.apply_propagation_rule(rule, token, token.astOperand1, token.astOperand2)
+            self.perform_intersection = False
+            if self.was_some_unit_changed:
+                pass_unit_changed = True
+
+            # RE-ENQUEUE DEPENDENTS OF WHATEVER CHANGED
+            changed = []
+            for (w, b) in zip(watched_at[i], before):
+                if snapshot(tokens[w]) != b:
+                    changed.append(w)
+                    if parent_at[w] is not None:
+                        changed.append(parent_at[w])
+                    changed.extend(readers_of[w])
+                    for f in argument_of[w]:
+                        changed.extend(function_readers.get(id(f), []))
+            for (f, b) in zip(functions_at[i], functions_before):
+                if function_snapshot(f) != b:
+                    changed.extend(function_readers.get(id(f), []))
+            for j in changed:
+                for rule in rules_at[j]:
+                    if (rule[0], j) in queued:
+                        continue
+                    queued.add((rule[0], j))
+                    item = (rule[0], j, rule)
+                    heapq.heappush(heap if item[:2] > current[:2] else next_heap, item)
+
+        self.was_some_unit_changed = False
+
+
+    def take_propagation_snapshot(self, token):
+        return (tuple(token.units), 
+                token.isKnown, 
+                token.isDimensionless, 
+                token.is_unit_propagation_based_on_constants, 
+                token.is_unit_propagation_based_on_unknown_variable, 
+                token.is_unit_propagation_based_on_weak_inference)
+
+
+    def take_function_snapshot(self, function):
+        ''' THE CONTENTS OF function.arg_units, NOT ONLY THEIR NUMBER:  AN arg_units ENTRY REFERS TO THE 
+            units LIST OF ITS ARGUMENT TOKEN, WHICH LATER RULES MAY EXTEND IN PLACE
+            '''
+        return (function.return_arg_var_nr, 
+                id(function.return_expr_root_token), 
+                tuple(tuple((d['linenr'], tuple(d['units']), id(d['token']), id(d['function'])) for d in a) 
+                      for a in function.arg_units))
+
+
+    def get_worklist_plan(self, root_token, rule_table):
+        ''' PRECOMPUTED DEPENDENCIES OF ONE AST FOR propagate_units_by_worklist
+            (TOKENS ARE INDEXED BY THEIR POST-ORDER POSITION)
+            returns: tuple (tokens, 
+                            rules at each token, 
+                            tokens a rule at each token may write, 
+                            functions a rule at each token may write, 
+                            parent of each token, 
+                            tokens whose rules read each token (besides itself and its parent), 
+                            dict id(function) -> tokens whose rules read that function, 
+                            functions each token is a call argument of)
+            AN arg_units ENTRY OF A FUNCTION SHARES THE units LIST OF ITS ARGUMENT TOKEN, SO A CHANGE TO THE 
+            ARGUMENT OF ONE CALL IS A CHANGE TO THE FUNCTION, FOR THE READERS OF EVERY CALL OF IT
+            '''
+        key = (id(root_token), id(rule_table))
+        if key in self.worklist_plans:
+            return self.worklist_plans[key]
+
+        (tokens, rules_at) = self.get_rules_in_postorder(root_token, rule_table)
+        position = {}
+        for (i, t) in enumerate(tokens):
+            position[id(t)] = i
+
+        def positions_of(some_tokens):
+            found = []
+            for t in some_tokens:
+                if t is not None and id(t) in position and position[id(t)] not in found:
+                    found.append(position[id(t)])
+            return found
+
+        watched_at = []
+        functions_at = []
+        parent_at = []
+        readers_of = [[] for t in tokens]
+        function_readers = {}
+        argument_of = [[] for t in tokens]
+        for (i, t) in enumerate(tokens):
+            parent_at.append((positions_of([t.astParent]) or [None])[0])
+
+            parent = t.astParent
+            grandparent = parent.astParent if parent else None
+            # WRITTEN BY RULES AT t:  t, TERNARY ':', UNIT RECEIVERS ( '(' ) AND THEIR COMMA TOKENS
+            watched_at.append(positions_of([t, t.astOperand2, 
+                                            parent, parent.astOperand2 if parent else None, 
+                                            grandparent, grandparent.astOperand2 if grandparent else None]))
+
+            # READ BY RULES AT t:  OPERANDS OF UNIT RECEIVERS, TERNARY BRANCHES, FUNCTION ARGUMENTS
+            read = []
+            for receiver in [parent, grandparent]:
+                if receiver:
+                    read += [receiver, receiver.astOperand1, receiver.astOperand2]
+                    if receiver.astOperand2:
+                        read += [receiver.astOperand2.astOperand1, receiver.astOperand2.astOperand2]
+            if t.astOperand2:
+                read += [t.astOperand2.astOperand1, t.astOperand2.astOperand2]
+            if t.function and parent and parent.astOperand2:
+                read += self.collect_function_arg_tokens(parent.astOperand2)
+                if hasattr(t.function, 'arg_units'):
+                    for r in positions_of(self.collect_function_arg_tokens(parent.astOperand2)):
+                        if t.function not in argument_of[r]:
+                            argument_of[r].append(t.function)
+            for r in positions_of(read):
+                if r != i and i not in readers_of[r]:
+                    readers_of[r].append(i)
+
+            # FUNCTION STATE (ARG UNITS, RETURN ARG) WRITTEN AND READ BY RULES AT t
+            functions = []
+            if t.function:
+                functions.append(t.function)
+            if t.str == 'return':
+                if t.scope and t.scope.function:
+                    functions.append(t.scope.function)
+                if t.astOperand1 and t.astOperand1.scope and t.astOperand1.scope.function:
+                    functions.append(t.astOperand1.scope.function)
+            if t.str == '(' and t.astOperand1 and t.astOperand1.function:
+                functions.append(t.astOperand1.function)
+            functions_at.append([f for f in functions if hasattr(f, 'arg_units')])
+            for f in functions_at[-1]:
+                function_readers.setdefault(id(f), [])
+                if i not in function_readers[id(f)]:
+                    function_readers[id(f)].append(i)
+
+        plan = (tokens, rules_at, watched_at, functions_at, parent_at, readers_of, function_readers, argument_of)
+        self.worklist_plans[key] = plan
+        return plan
+
+
+    def collect_function_arg_tokens(self, token):
+        ''' ARGUMENT TOKENS OF A CALL, FOLLOWING NESTED ',' TOKENS (SEE recurse_on_function_args)
+            '''
+        if token.str != ',':
+            return [token]
+        arg_tokens = [token]
+        if token.astOperand1:
+            arg_tokens += self.collect_function_arg_tokens(token.astOperand1)
+        if token.astOperand2:
+            arg_tokens.append(token.astOperand2)
+        return arg_tokens
+
+
     def find_min_max_line_numbers(self, token, left_token, right_token):
         ''' FIND THE MIN AND MAX LINE NUMBERS FOR THIS AST,
                 PROTECT FROM MULTI-LINE STATEMENTS
@@ -117,34 +473,16 @@ class TreeWalker:
             (token, var_name) = self.my_symbol_helper.find_compound_variable_and_name_for_variable_token(token)
             if not token:
                 return
-            #TODO improve by storing variable id in the datastructures instead of variable object
-            for (token_variable, name) in con.variable2unitproba:
-                if (token_variable.Id == token.variable.Id) and (name == var_name):
-                    n = 3
-                    if con.is_only_known_unit_variable(token_variable, name):
-                        n = 1
-
-                    #units = con.variable2unitproba[(token_variable, var_name)][:n]
-                    #units = filter(lambda (u, p): p > con.unit_prob_threshold, units)
-                    #units = map(lambda (u, p): u, units)
-                    #if con.ENABLE_UNIT_LIST_FLATTENING:
-                    #    units = con.flatten_unit_list(units)
-
-                    units = con.variable2unitproba[(token_variable, var_name)]
-                    units = filter(lambda (u, p): p > con.unit_prob_threshold, units)
-                    probas = map(lambda (u, p): p, units)
-                    probas = list(set(probas))
-                    probas = sorted(probas, reverse=True)
-                    probas = probas[:n]
-                    units = filter(lambda (u, p): p in probas, units)
-                    units = map(lambda (u, p): u, units)
-                    if con.ENABLE_UNIT_LIST_FLATTENING:
-                        units = con.flatten_unit_list(units)
-
-                    token.units = units
-                    self.was_some_unit_changed = True
-                    self.found_units_in_this_tree = True
-                    break
+            unitproba_key = self.con.find_unitproba_key(token.variable, var_name)
+            if unitproba_key:
+                (token_variable, name) = unitproba_key
+                n = 3
+                if self.con.is_only_known_unit_variable(token_variable, name):
+                    n = 1
+
+                token.units = self.con.get_top_units(unitproba_key, n)
+                self.was_some_unit_changed = True
+                self.found_units_in_this_tree = True
 
 
     def apply_correction_units(self, token, left_token, right_token):
@@ -152,9 +490,9 @@ class TreeWalker:
             (token, var_name) = self.my_symbol_helper.find_compound_variable_and_name_for_variable_token(token)
             if not token:
                 return
-            if var_name in con.phys_corrections:
-                token.units = (con.phys_corrections)[var_name]
-                if token.units == [{'dimensionless': 1.0}]:
+            if var_name in self.con.phys_corrections:
+                token.units = (self.con.phys_corrections)[var_name]
+                if token.units == [phys_unit.DIMENSIONLESS]:
                     token.units = []
                 self.was_some_unit_changed = True
                 self.found_units_in_this_tree = True
@@ -178,7 +516,7 @@ class TreeWalker:
                 self.found_units_in_this_tree = True
                 
                 if (token.str != 'dt'):
-                    con.found_ros_units = True
+                    self.con.found_ros_units = True
                 else:
                     token.isKnown = False
                 
@@ -198,7 +536,7 @@ class TreeWalker:
                 a_dict = self.my_symbol_helper.ros_unit_dictionary[token.str][token.str]
 
         if token.str in ['cos', 'sin', 'tan']:
-            a_dict = {'nounit': 0.0}
+            a_dict = phys_unit.NOUNIT
 
         if a_dict and (a_dict not in token.units):
             token.units.append(a_dict)
@@ -255,29 +593,29 @@ class TreeWalker:
         if token.isArithmeticalOp and (token.str == '/'):
             if right_token.str in ['180', '180.0', '180.0f']:
                 if left_token.str[:4] in ['M_PI', '3.14']:
-                    a_dict = {'radian_unit': 1.0}
+                    a_dict = phys_unit.RADIAN_UNIT
                     token = left_token
                 elif left_token.str == '*' and (left_token.astOperand2.str[:4] in ['M_PI', '3.14'] or \
                         left_token.astOperand1.str[:4] in ['M_PI', '3.14']):
                     token = right_token
-                    a_dict = {'radian_unit': 1.0} 
+                    a_dict = phys_unit.RADIAN_UNIT 
             elif right_token.str[:4] in ['M_PI', '3.14']:
                 if left_token.str in ['180', '180.0', '180.0f']:
-                    a_dict = {'degree_360_unit': 1.0}
+                    a_dict = phys_unit.DEGREE_360_UNIT
                 elif left_token.str == '*' and (left_token.astOperand2.str in ['180', '180.0', '180.0f'] or \
                         left_token.astOperand1.str in ['180', '180.0', '180.0f']):
                     token = right_token
-                    a_dict = {'degree_360_unit': 1.0}
+                    a_dict = phys_unit.DEGREE_360_UNIT
         
         elif token.isArithmeticalOp and (token.str == '*'):
             if right_token and right_token.str[:4] in ['M_PI', '3.14']:
                 if left_token.str == '/' and left_token.astOperand2.str in ['180', '180.0', '180.0f']:
                     token = left_token.astOperand2
-                    a_dict = {'radian_unit': 1.0}
+                    a_dict = phys_unit.RADIAN_UNIT
             elif right_token and right_token.str in ['180', '180.0', '180.0f']:
                 if left_token.str == '/' and left_token.astOperand2.str[:4] in ['M_PI', '3.14']:
                     token = left_token.astOperand2
-                    a_dict = {'degree_360_unit': 1.0}
+                    a_dict = phys_unit.DEGREE_360_UNIT
             
         if a_dict and (a_dict not in token.units):
             token.units.append(a_dict)
@@ -312,16 +650,16 @@ class TreeWalker:
             (token, var_name) = self.my_symbol_helper.find_compound_variable_and_name_for_variable_token(token)
             if not token:
                 return
-            if (token.variable, var_name) in con.variable2unitproba:
-                if len(con.variable2unitproba[(token.variable, var_name)]) >= 2:
-                    unit, proba = con.variable2unitproba[(token.variable, var_name)][0]
-                    unit2, proba2 = con.variable2unitproba[(token.variable, var_name)][1]
+            if (token.variable, var_name) in self.con.variable2unitproba:
+                if len(self.con.variable2unitproba[(token.variable, var_name)]) >= 2:
+                    unit, proba = self.con.variable2unitproba[(token.variable, var_name)][0]
+                    unit2, proba2 = self.con.variable2unitproba[(token.variable, var_name)][1]
                 else:
-                    unit, proba = con.variable2unitproba[(token.variable, var_name)][0]
+                    unit, proba = self.con.variable2unitproba[(token.variable, var_name)][0]
                     proba2 = 0.0
                 proba = round(proba, 7)
                 proba2 = round(proba2, 7)
-                if (proba > con.unit_prob_threshold) and (unit not in token.units) and (proba != proba2):
+                if (proba > self.con.unit_prob_threshold) and (unit not in token.units) and (proba != proba2):
                     #print var_name, unit, proba
                     if isinstance(unit, list):
                         token.units = unit
@@ -336,7 +674,7 @@ class TreeWalker:
             (token, var_name) = self.my_symbol_helper.find_compound_variable_and_name_for_variable_token(token)
             if not token:
                 return
-            if (token.variable, var_name) in con.dimensionless_variables:
+            if (token.variable, var_name) in self.con.dimensionless_variables:
                 token.units = []
                 token.isDimensionless = True
                 self.was_some_unit_changed = True
@@ -364,18 +702,18 @@ class TreeWalker:
                     rtype = self.my_symbol_helper.find_variable_type(right_token.variable)
                     rtype = rtype.lower()
                     if (lunit and ('int' in rtype)):
-                        con.add_int_unit_variable(right_token, right_name)
+                        self.con.add_int_unit_variable(right_token, right_name)
                         return
                     if (runit and ('int' in ltype)):
-                        con.add_int_unit_variable(left_token, left_name)
+                        self.con.add_int_unit_variable(left_token, left_name)
                         return
                         
                 if (not lunit) and (runit):
                     if right_token.variable:
-                        con.add_non_unit_variable(right_token, right_name)
+                        self.con.add_non_unit_variable(right_token, right_name)
                 elif (lunit) and (not runit):
                     if left_token.variable:
-                        con.add_non_unit_variable(left_token, left_name)      
+                        self.con.add_non_unit_variable(left_token, left_name)      
 
 
     def add_df_constraint(self, left_token, left_name, right_token, right_name, df_type=con.DF_1):
@@ -388,7 +726,7 @@ class TreeWalker:
         b1 = self.my_symbol_helper.should_have_unit(left_token, left_name)
         b2 = self.my_symbol_helper.should_have_unit(right_token, right_name)
         if (b1 and b2): 
-            con.add_df_constraint(left_token, left_name, right_token, right_name, df_type)
+            self.con.add_df_constraint(left_token, left_name, right_token, right_name, df_type)
 
 
     def collect_same_unit_constraints(self, token, left_token, right_token):
@@ -569,9 +907,9 @@ class TreeWalker:
 
         elif token.isOp and token.str in ['*', '/'] and (not token.is_unit_propagation_based_on_constants):
             nounit = True
-            if [{'nounit': 0.0}] == left_token.units:
+            if [phys_unit.NOUNIT] == left_token.units:
                 left_token = right_token
-            elif right_token and ([{'nounit': 0.0}] == right_token.units):
+            elif right_token and ([phys_unit.NOUNIT] == right_token.units):
                 left_token = left_token
             else:
                 nounit = False
@@ -603,19 +941,19 @@ class TreeWalker:
 
             #IF EXPR LIKE A*COS(P)+B*SIN(Q)
             if left_token.str in ['*', '/']:
-                if [{'nounit': 0.0}] == left_token.astOperand1.units:
+                if [phys_unit.NOUNIT] == left_token.astOperand1.units:
                     left_token = left_token.astOperand2
                     left_nounit = True
-                elif left_token.astOperand2 and ([{'nounit': 0.0}] == left_token.astOperand2.units):
+                elif left_token.astOperand2 and ([phys_unit.NOUNIT] == left_token.astOperand2.units):
                     left_token = left_token.astOperand1
                     left_nounit = True
             
             
             if right_token and right_token.str in ['*', '/']:
-                if [{'nounit': 0.0}] == right_token.astOperand1.units:
+                if [phys_unit.NOUNIT] == right_token.astOperand1.units:
                     right_token = right_token.astOperand2
                     right_nounit = True
-                elif right_token.astOperand2 and ([{'nounit': 0.0}] == right_token.astOperand2.units):
+                elif right_token.astOperand2 and ([phys_unit.NOUNIT] == right_token.astOperand2.units):
                     right_token = right_token.astOperand1
                     right_nounit = True
 
@@ -736,8 +1074,8 @@ class TreeWalker:
                     #if root_token.astOperand2.is_unit_propagation_based_on_constants:
                     #    return
 
-                    if ({'degree_360_unit': -1.0} in root_token.astOperand2.units) or \
-                           ({'radian_unit': -1.0} in root_token.astOperand2.units): #or \
+                    if (phys_unit.PER_DEGREE_360_UNIT in root_token.astOperand2.units) or \
+                           (phys_unit.PER_RADIAN_UNIT in root_token.astOperand2.units): #or \
                            #({'nounit': 0.0} in root_token.astOperand2.units):
                         return
 
@@ -754,9 +1092,9 @@ class TreeWalker:
                     if not (self.my_symbol_helper.should_have_unit(lhs_var_token, lhs_name)):
                         return
 
-                    if ({'nounit': 0.0} in root_token.astOperand2.units):
-                        if root_token.astOperand2.units == [{'nounit': 0.0}]:
-                            con.add_dimensionless_variable(lhs_var_token, lhs_name)
+                    if (phys_unit.NOUNIT in root_token.astOperand2.units):
+                        if root_token.astOperand2.units == [phys_unit.NOUNIT]:
+                            self.con.add_dimensionless_variable(lhs_var_token, lhs_name)
                         return
 
                     # SCAN RHS VARIABLES
@@ -769,26 +1107,26 @@ class TreeWalker:
                     uk = (not self.found_known_unit_variable_in_rhs)
 
                     if (not lhs_var_token.isKnown):
-                        con.add_known_unit_variable(lhs_var_token, lhs_name, k, uk)
+                        self.con.add_known_unit_variable(lhs_var_token, lhs_name, k, uk)
 
                     # TRACK VARIABLE WITH MULTIPLE UNITS
                     if len(root_token.astOperand2.units) > 1:              
-                        con.add_multi_unit_variable(root_token, lhs_var_token, lhs_name, root_token.astOperand2.units, k)
+                        self.con.add_multi_unit_variable(root_token, lhs_var_token, lhs_name, root_token.astOperand2.units, k)
 
                     if lhs_var_token.isKnown:
                         if (len(root_token.astOperand2.units) == 1) and (lhs_var_token.units != root_token.astOperand2.units):
                             units = []
                             units.extend(lhs_var_token.units)
                             units.extend(root_token.astOperand2.units)
-                            con.add_multi_unit_variable(root_token, lhs_var_token, lhs_name, units, k)
+                            self.con.add_multi_unit_variable(root_token, lhs_var_token, lhs_name, units, k)
                         return
                 
                     # COLLECT CONSTRAINT
                     isKnown = root_token.astOperand2.isKnown and (not self.found_non_ros_unit_variable_in_rhs) 
-                    con.add_cu_constraint(lhs_var_token, lhs_name, root_token.astOperand2.units, isKnown)
+                    self.con.add_cu_constraint(lhs_var_token, lhs_name, root_token.astOperand2.units, isKnown)
 
                     # ChECK WHEN LHS IS KNOWN UNIT VARIABLE
-                    if (check_known_unit_variable) and (con.is_only_known_unit_variable(lhs_var_token.variable, lhs_name)):
+                    if (check_known_unit_variable) and (self.con.is_only_known_unit_variable(lhs_var_token.variable, lhs_name)):
                         self.process_lhs_known_unit_variable(root_token, 
                                                              lhs_var_token, lhs_name, k,                 
                                                              root_token.astOperand2.units)
@@ -811,7 +1149,7 @@ class TreeWalker:
                         return
 
                     if root_token.astOperand2.isDimensionless:
-                        con.add_dimensionless_variable(lhs_var_token, lhs_name)
+                        self.con.add_dimensionless_variable(lhs_var_token, lhs_name)
                     
                     # SCAN RHS VARIABLES
                     self.found_non_known_unit_variable_in_rhs = False
@@ -822,7 +1160,7 @@ class TreeWalker:
                     k = (not self.found_non_known_unit_variable_in_rhs) and (self.found_known_unit_variable_in_rhs)
                     uk = (not self.found_known_unit_variable_in_rhs)
 
-                    con.add_known_unit_variable(lhs_var_token, lhs_name, k, uk)
+                    self.con.add_known_unit_variable(lhs_var_token, lhs_name, k, uk)
             #else:
             #    pass
 
@@ -833,10 +1171,10 @@ class TreeWalker:
             if not token:
                 return
 
-            if (not token.isKnown) and (not con.is_only_known_unit_variable(token.variable, var_name)):
+            if (not token.isKnown) and (not self.con.is_only_known_unit_variable(token.variable, var_name)):
                 self.found_non_known_unit_variable_in_rhs = True
 
-            if (token.isKnown) or (con.is_only_known_unit_variable(token.variable, var_name)):
+            if (token.isKnown) or (self.con.is_only_known_unit_variable(token.variable, var_name)):
                 self.found_known_unit_variable_in_rhs = True
 
             if (not token.isKnown) and (self.my_symbol_helper.should_have_unit(token, var_name)):
@@ -849,16 +1187,16 @@ class TreeWalker:
             units = []
             units.extend(lhs_var_token.units)
             units.extend(rhs_units)
-            #con.add_multi_unit_variable(root_token, lhs_var_token, lhs_name, units, k)
+            #self.con.add_multi_unit_variable(root_token, lhs_var_token, lhs_name, units, k)
 
         # PROCESS CU CONSTRAINTS
-        con.scan_and_create_cu_constraints(lhs_var_token, lhs_name)
+        self.con.scan_and_create_cu_constraints(lhs_var_token, lhs_name)
 
 
     def add_ks_constraint(self, token, name, units):
         if not (self.my_symbol_helper.should_have_unit(token, name)):
             return
-        con.add_ks_constraint(token, name, units)
+        self.con.add_ks_constraint(token, name, units)
 
 
     def collect_known_symbol_constraints(self, token, left_token, right_token):
@@ -872,28 +1210,28 @@ class TreeWalker:
 
                 # COLLECT CONSTRAINT
                 if token.variable:
-                    self.add_ks_constraint(token, name, [{'radian': 1.0}])
+                    self.add_ks_constraint(token, name, [phys_unit.RADIAN])
 
 
     def add_cf_constraint(self, token, name, units, cf_type=con.CF_1):
         if not (self.my_symbol_helper.should_have_unit(token, name)):
             return
 
-        if (cf_type == con.CF_1) and ({'second': -1.0} in token.units):
-            if units == [{'degree_360': 1.0}]:
-                units = [{'degree_360': 1.0, 'second': -1.0}]
-            elif units == [{'radian': 1.0}]:
-                units = [{'second': -1.0}]
+        if (cf_type == con.CF_1) and (phys_unit.PER_SECOND in token.units):
+            if units == [phys_unit.DEGREE_360]:
+                units = [phys_unit.DEGREE_360_PER_SECOND]
+            elif units == [phys_unit.RADIAN]:
+                units = [phys_unit.PER_SECOND]
         
-        con.add_cf_constraint(token, name, units, cf_type)
+        self.con.add_cf_constraint(token, name, units, cf_type)
 
 
     #TODO handle all cases
     def collect_conversion_factor_constraints(self, token, left_token, right_token):
         #if token.str in ['=', '+=', '-=']:
             if (right_token and right_token.str == '/'and right_token.astOperand2) and \
-                    (({'degree_360_unit': 1.0} in right_token.astOperand2.units) or \
-                     ({'radian_unit': 1.0} in right_token.astOperand2.units)):
+                    ((phys_unit.DEGREE_360_UNIT in right_token.astOperand2.units) or \
+                     (phys_unit.RADIAN_UNIT in right_token.astOperand2.units)):
 
                 top_right_token_unit = right_token.astOperand2.units
                 right_token = right_token.astOperand1
@@ -910,7 +1248,7 @@ class TreeWalker:
                     self.my_symbol_helper.find_compound_variable_and_name_for_dot_operand(right_token)
                  
                 if (right_token.variable) and (not right_token.isKnown): #(not right_token.units):
-                    unit = [{'radian': 1.0}] if (top_right_token_unit == [{'degree_360_unit': 1.0}]) else [{'degree_360': 1.0}]
+                    unit = [phys_unit.RADIAN] if (top_right_token_unit == [phys_unit.DEGREE_360_UNIT]) else [phys_unit.DEGREE_360]
                     self.add_cf_constraint(right_token, right_name, unit)
 
                 if token.str not in ['=', '+=', '-=']:
@@ -922,19 +1260,19 @@ class TreeWalker:
 
                 #if (not left_token.units):
                 if (not left_token.isKnown):
-                    unit = [{'degree_360': 1.0}] if (top_right_token_unit == [{'degree_360_unit': 1.0}]) else [{'radian': 1.0}]
+                    unit = [phys_unit.DEGREE_360] if (top_right_token_unit == [phys_unit.DEGREE_360_UNIT]) else [phys_unit.RADIAN]
                     self.add_cf_constraint(left_token, left_name, unit)
 
             elif (right_token and right_token.str == '*' and right_token.astOperand1 and right_token.astOperand2): 
 
-                if (({'radian_unit': 1.0} in right_token.astOperand1.units) or \
-                    ({'degree_360_unit': 1.0} in right_token.astOperand1.units)):                    
+                if ((phys_unit.RADIAN_UNIT in right_token.astOperand1.units) or \
+                    (phys_unit.DEGREE_360_UNIT in right_token.astOperand1.units)):                    
                     top_right_token_unit = right_token.astOperand1.units
                     right_token = right_token.astOperand2
                 
                 elif (right_token.astOperand1.str == '/'and right_token.astOperand1.astOperand2) and \
-                        (({'degree_360_unit': 1.0} in right_token.astOperand1.astOperand2.units) or \
-                         ({'radian_unit': 1.0} in right_token.astOperand1.astOperand2.units)):
+                        ((phys_unit.DEGREE_360_UNIT in right_token.astOperand1.astOperand2.units) or \
+                         (phys_unit.RADIAN_UNIT in right_token.astOperand1.astOperand2.units)):
                     top_right_token_unit = right_token.astOperand1.astOperand2.units
                     right_token = right_token.astOperand1.astOperand1
 
@@ -948,7 +1286,7 @@ class TreeWalker:
 
                 #if (not right_token.units):
                 if (right_token.variable) and (not right_token.isKnown):
-                    unit = [{'radian': 1.0}] if (top_right_token_unit == [{'degree_360_unit': 1.0}]) else [{'degree_360': 1.0}]
+                    unit = [phys_unit.RADIAN] if (top_right_token_unit == [phys_unit.DEGREE_360_UNIT]) else [phys_unit.DEGREE_360]
                     self.add_cf_constraint(right_token, right_name, unit)
 
                 if token.str not in ['=', '+=', '-=']:
@@ -960,7 +1298,7 @@ class TreeWalker:
 
                 #if (not left_token.units):
                 if (not left_token.isKnown):
-                    unit = [{'degree_360': 1.0}] if (top_right_token_unit == [{'degree_360_unit': 1.0}]) else [{'radian': 1.0}] 
+                    unit = [phys_unit.DEGREE_360] if (top_right_token_unit == [phys_unit.DEGREE_360_UNIT]) else [phys_unit.RADIAN] 
                     self.add_cf_constraint(left_token, left_name, unit)
 
 
@@ -983,9 +1321,9 @@ class TreeWalker:
                             self.my_symbol_helper.find_compound_variable_and_name_for_dot_operand(right_token)
 
                 if (left_token.variable) and (right_token.str[:4] in ['M_PI', '3.14']):
-                    self.add_cf_constraint(left_token, left_name, [{'radian': 1.0}], con.CF_3)
+                    self.add_cf_constraint(left_token, left_name, [phys_unit.RADIAN], con.CF_3)
                 elif (right_token.variable) and (left_token.str[:4] in ['M_PI', '3.14']):
-                    self.add_cf_constraint(right_token, right_name, [{'radian': 1.0}], con.CF_3)
+                    self.add_cf_constraint(right_token, right_name, [phys_unit.RADIAN], con.CF_3)
 
 
     def collect_angle_unit_constraints_II(self, token, left_token, right_token):
@@ -1002,18 +1340,18 @@ class TreeWalker:
 
                 if (token.str in ['+=', '-=', '=']) and self.current_child_vars:
                     if left_token.variable:
-                        self.add_cf_constraint(left_token, left_name, [{'degree_360': 1.0}], con.CF_2)
+                        self.add_cf_constraint(left_token, left_name, [phys_unit.DEGREE_360], con.CF_2)
                     self.current_child_vars = []
 
-                if ({'radian': 1.0} in left_token.units) and right_token.isNumber and (abs(float(self.clean_float_string(right_token.str))) > 6.3):
+                if (phys_unit.RADIAN in left_token.units) and right_token.isNumber and (abs(float(self.clean_float_string(right_token.str))) > 6.3):
                     # number approx greater than 2*pi value
                     if left_token.variable:
-                        self.add_cf_constraint(left_token, left_name, [{'degree_360': 1.0}], con.CF_2) 
+                        self.add_cf_constraint(left_token, left_name, [phys_unit.DEGREE_360], con.CF_2) 
                     self.current_child_vars.append((left_token, left_name))
-                elif ({'radian': 1.0} in right_token.units) and left_token.isNumber and (abs(float(self.clean_float_string(left_token.str))) > 6.3):
+                elif (phys_unit.RADIAN in right_token.units) and left_token.isNumber and (abs(float(self.clean_float_string(left_token.str))) > 6.3):
                     # number approx greater than 2*pi value
                     if right_token.variable:
-                        self.add_cf_constraint(right_token, right_name, [{'degree_360': 1.0}], con.CF_2)
+                        self.add_cf_constraint(right_token, right_name, [phys_unit.DEGREE_360], con.CF_2)
                     self.current_child_vars.append((right_token, right_name))
                 else:
                     self.current_child_vars = []
@@ -1037,30 +1375,30 @@ class TreeWalker:
                 return
                         
             #TODO should we store variable object instead of token?
-            var = con.get_variable_id(token, var_name)
-            if (var and (not con.is_nm_constraint_present(var))) or (not var):
+            var = self.con.get_variable_id(token, var_name)
+            if (var and (not self.con.is_nm_constraint_present(var))) or (not var):
                 #print var_name, token.file, token.linenr
                 estimation_dict = self.type_miner.predict_proba(var_name)
                 if estimation_dict:
                     estimation_list_sorted = sorted(estimation_dict.items(), key=itemgetter(1))
                     estimation_list_sorted.reverse()
-                    estimation_list_sorted = map(lambda (u, p): (eval(u), p), estimation_list_sorted)
+                    estimation_list_sorted = map(lambda (u, p): (phys_unit.unit_from_str(u), p), estimation_list_sorted)
 
                     est_list = estimation_list_sorted[:3]
                     i = 0
                     for (u, p) in est_list:
                         #(u, p) = estimation_list_sorted[0]
-                        if u in [{'meter': 1.0, 'second': -1.0}, {'meter': 1.0, 'second': -2.0}]:
+                        if u in [phys_unit.METER_PER_SECOND, phys_unit.METER_PER_SECOND_SQUARED]:
                             if any(substr in var_name.lower() for substr in ['th', 'ang', 'rot', 'yaw', 'pan', 'tilt']):
-                                if u == {'meter': 1.0, 'second': -1.0}:
-                                    estimation_list_sorted[i] = ({'second': -1.0}, p)
-                                elif u == {'meter': 1.0, 'second': -2.0}:
-                                    estimation_list_sorted[i] = ({'second': -2.0}, p)
+                                if u == phys_unit.METER_PER_SECOND:
+                                    estimation_list_sorted[i] = (phys_unit.PER_SECOND, p)
+                                elif u == phys_unit.METER_PER_SECOND_SQUARED:
+                                    estimation_list_sorted[i] = (phys_unit.PER_SECOND_SQUARED, p)
                         i+=1
 
-                    con.add_nm_constraint(token, var_name, estimation_list_sorted)
+                    self.con.add_nm_constraint(token, var_name, estimation_list_sorted)
                 else:
-                    con.add_nm_constraint(token, var_name, [({},0.0)])
+                    self.con.add_nm_constraint(token, var_name, [({},0.0)])
 
 
     def collect_deep_network_naming_constraints(self, token, left_token, right_token):
@@ -1086,8 +1424,8 @@ class TreeWalker:
                 return
                         
             #TODO should we store variable object instead of token?
-            var = con.get_variable_id(token, var_name)
-            if (var and (not con.is_nm_constraint_present(var))) or (not var):
+            var = self.con.get_variable_id(token, var_name)
+            if (var and (not self.con.is_nm_constraint_present(var))) or (not var):
                 #print var_name, token.file, token.linenr
                 estimation_dict = self.vnh.predict_units_for_var_name(var_name, 'lstm_most_common')
                 if estimation_dict:
@@ -1098,9 +1436,9 @@ class TreeWalker:
                     # print ('%s: %s' % (var_name, estimation_list_sorted))
                     # estimation_list_sorted = map(lambda (u, p): (u, p), estimation_list_sorted)
                     # estimation_list_sorted = map(lambda (u, p): (eval(u), p), estimation_list_sorted)
-                    con.add_nm_constraint(token, var_name, estimation_list_sorted)
+                    self.con.add_nm_constraint(token, var_name, estimation_list_sorted)
                 else:
-                    con.add_nm_constraint(token, var_name, [({},0.0)])
+                    self.con.add_nm_constraint(token, var_name, [({},0.0)])
 
 
     def propagate_units_across_connectors(self, token, left_token, right_token, connector):
@@ -1148,10 +1486,10 @@ class TreeWalker:
 
     def propagate_units_across_parenthesis(self, token, left_token, right_token):
         if token.str == '(':
-            if left_token.function or ({'nounit': 0.0} in left_token.units):
+            if left_token.function or (phys_unit.NOUNIT in left_token.units):
                 # IF LEFT SIDE IS A FUNCTION, PROPAGATE ITS RETURN UNITS
                 if (left_token.function and (not left_token.function.maybe_generic_function)) or \
-                        ({'nounit': 0.0} in left_token.units):
+                        (phys_unit.NOUNIT in left_token.units):
                     self.update_units_from_to(left_token, token)
         
                 if (not token.units):
@@ -1261,11 +1599,8 @@ class TreeWalker:
             new_units = self.merge_units_by_set_union(left_units, right_units)
 
             # DIVIDE UNITS BY TWO
-            for u in new_units:
-                if u in self.my_symbol_helper.dimensionless_units:
-                    continue
-                for k, v in u.iteritems():
-                    u[k] = v / 2.
+            new_units = [u if self.my_symbol_helper.is_dimensionless_unit(u) else phys_unit.sqrt(u)
+                         for u in new_units]
 
             # ATTEMPT TO PROPAGATE UNITS ACROSS '('
             for u in new_units:
@@ -1345,15 +1680,8 @@ class TreeWalker:
                 power_exponent = float(s)
                 if comma_token.astOperand1.units:
                     # APPLY POWER TO UNITS
-                    new_units = []
-                    # FIRST, DEEPCOPY
-                    new_units = copy.deepcopy(comma_token.astOperand1.units)
-                    # NEXT, APPLY EXPONENET
-                    for unit_dict in new_units:
-                        if unit_dict in self.my_symbol_helper.dimensionless_units:
-                            continue
-                        for k, v in unit_dict.iteritems():
-                            unit_dict[k] = power_exponent * v
+                    new_units = [u if self.my_symbol_helper.is_dimensionless_unit(u) else phys_unit.power(u, power_exponent)
+                                 for u in comma_token.astOperand1.units]
 
                     for u in new_units:
                         if u not in unit_receiver.units:
@@ -1475,15 +1803,13 @@ class TreeWalker:
 
             new_units = self.merge_units_by_set_union(left_units, right_units)
 
-            if new_units == [{'nounit': 0.0}]:
+            if new_units == [phys_unit.NOUNIT]:
                 new_units = []
  
             # CHECK FOR DIVISION AND EMPTY LEFT BRANCH
             if token.str in ['/', '/='] and not left_units:
                 # FLIP SIGNS ON NEW UNITS
-                for u in new_units:
-                    for k, v in u.iteritems():
-                        u[k] = -1 * v
+                new_units = [phys_unit.inverse(u) for u in new_units]
             # WEAKEN INFERENCE IF WE'RE MULTIPLYING OR
             # DIVIDING ON CONSTANTS OR UNKNOWN VARIABLES
             if token.str in ['*', '/', '*=', '/=']:
@@ -1524,13 +1850,16 @@ class TreeWalker:
                                 token.str)
                         if result_units:
                             all_unit_dicts_from_multiplication.append(result_units)
+                unit_bit = self.con.unit_vocabulary.unit_bit
+                new_units_mask = 0
                 for u in all_unit_dicts_from_multiplication:
-                    if u not in new_units:
+                    if not (unit_bit(u) & new_units_mask):
                         new_units.append(u)
+                        new_units_mask |= unit_bit(u)
 
                 if new_units == []:
                     token.isDimensionless = True
-                elif {'wrong': 0.0} in new_units:
+                elif phys_unit.WRONG in new_units:
                     new_units = []
 
         # UNIFY TOKENS FROM CHILDREN WITH CURRENT TOKEN
@@ -1549,7 +1878,7 @@ class TreeWalker:
             input:  unit_dict_left   dictionary of units, eg:  {'m':1, 's':-1} 
                     unit_dict_right  same
                     op   string representing mult or div operators
-            returns: new dict  with resulting units  eg: {'m':2, 's':-2}
+            returns: interned PhysUnit  with resulting units  eg: {'m':2, 's':-2}
             '''
         
         #if unit_dict_left == {'radian': 1.0} and unit_dict_right == {'degree_360_unit': 1.0}:
@@ -1561,71 +1890,54 @@ class TreeWalker:
         #elif unit_dict_left == {'radian_unit': 1.0} and unit_dict_right == {'degree_360': 1.0}:
         #    return {'radian': 1.0}
 
-        if unit_dict_right == {'degree_360_unit': 1.0}:
-            if unit_dict_left == {'radian': 1.0}:
-                return {'degree_360': 1.0}
-            elif unit_dict_left == {'second': -1.0}:
-                return {'degree_360': 1.0, 'second': -1.0}
+        if unit_dict_right == phys_unit.DEGREE_360_UNIT:
+            if unit_dict_left == phys_unit.RADIAN:
+                return phys_unit.DEGREE_360
+            elif unit_dict_left == phys_unit.PER_SECOND:
+                return phys_unit.DEGREE_360_PER_SECOND
             else:
-                return {'wrong': 0.0}
-        elif unit_dict_left == {'degree_360_unit': 1.0}:
-            if unit_dict_right == {'radian': 1.0}:
-                return {'degree_360': 1.0}
-            elif unit_dict_right == {'second': -1.0}:
-                return {'degree_360': 1.0, 'second': -1.0}
+                return phys_unit.WRONG
+        elif unit_dict_left == phys_unit.DEGREE_360_UNIT:
+            if unit_dict_right == phys_unit.RADIAN:
+                return phys_unit.DEGREE_360
+            elif unit_dict_right == phys_unit.PER_SECOND:
+                return phys_unit.DEGREE_360_PER_SECOND
             else:
-                return {'wrong': 0.0}
-        elif unit_dict_right == {'radian_unit': 1.0}:
-            if unit_dict_left == {'degree_360': 1.0}:
-                return {'radian': 1.0}
-            elif unit_dict_left == {'degree_360': 1.0, 'second': -1.0}:
-                return {'second': -1.0}
+                return phys_unit.WRONG
+        elif unit_dict_right == phys_unit.RADIAN_UNIT:
+            if unit_dict_left == phys_unit.DEGREE_360:
+                return phys_unit.RADIAN
+            elif unit_dict_left == phys_unit.DEGREE_360_PER_SECOND:
+                return phys_unit.PER_SECOND
             else:
-                return {'wrong': 0.0}
-        elif unit_dict_left == {'radian_unit': 1.0}:
-            if unit_dict_right == {'degree_360': 1.0}:
-                return {'radian': 1.0}
-            elif unit_dict_right == {'degree_360': 1.0, 'second': -1.0}:
-                return {'second': -1.0}
+                return phys_unit.WRONG
+        elif unit_dict_left == phys_unit.RADIAN_UNIT:
+            if unit_dict_right == phys_unit.DEGREE_360:
+                return phys_unit.RADIAN
+            elif unit_dict_right == phys_unit.DEGREE_360_PER_SECOND:
+                return phys_unit.PER_SECOND
             else:
-                return {'wrong': 0.0}
-
-        return_dict = {}
+                return phys_unit.WRONG
 
         # SPECIAL HANDLING FOR RADIANS AND QUATERNIONS
-        if unit_dict_left in self.my_symbol_helper.dimensionless_units \
-                and unit_dict_right in self.my_symbol_helper.dimensionless_units:
+        if self.my_symbol_helper.is_dimensionless_unit(unit_dict_left) \
+                and self.my_symbol_helper.is_dimensionless_unit(unit_dict_right):
             # SPECIAL CASE BOTH ARE RADIANS.  CLOSED UNDER MULTIPLICATION
             if op in ['*', '*=']:
-                return copy.deepcopy(unit_dict_left)
-        elif unit_dict_left in self.my_symbol_helper.dimensionless_units:
+                return unit_dict_left
+        elif self.my_symbol_helper.is_dimensionless_unit(unit_dict_left):
             # DON'T PROPAGATE RADIANS
             unit_dict_left = {}
-        elif unit_dict_right in self.my_symbol_helper.dimensionless_units:
+        elif self.my_symbol_helper.is_dimensionless_unit(unit_dict_right):
             # DON'T PROPAGATE RADIANS
             unit_dict_right = {}
 
-        return_dict = copy.deepcopy(unit_dict_left)
-        for unit in unit_dict_right:
-            if unit in return_dict:
-                # BOTH DICTS HAVE SAME UNIT
-                if op in ['*', '*=']:
-                    # ADD OF EXPONENT IS MULT
-                    return_dict[unit] += unit_dict_right[unit]
-                elif op in ['/', '/=']:
-                    # SUBTRACTION OF EXPONENT IS DIV
-                    return_dict[unit] -= unit_dict_right[unit]
-            else:
-                # ONLY ONE SIDE HAS UNIT
-                if op in ['*', '*=']:
-                    # COPY - THIS IS NOT A REFERNCE
-                    return_dict[unit] = unit_dict_right[unit]
-                elif op in ['/', '/=']:
-                    return_dict[unit] = -1 * unit_dict_right[unit]
-
-        # FILTER OUT ZEROs - UNITLESS
-        return_dict = {k: v for k, v in return_dict.items() if v != 0}
-        return return_dict
+        # ADD OF EXPONENT IS MULT, SUBTRACTION OF EXPONENT IS DIV  (ZEROS - UNITLESS - ARE FILTERED OUT)
+        if op in ['*', '*=']:
+            return phys_unit.multiply(unit_dict_left, unit_dict_right)
+        elif op in ['/', '/=']:
+            return phys_unit.divide(unit_dict_left, unit_dict_right)
+        return phys_unit.multiply(unit_dict_left, {})
       
 
     def merge_units_by_set_union(self, left_units, right_units):
@@ -1636,21 +1948,27 @@ class TreeWalker:
             return self.merge_units_by_set_intersection(left_units, right_units)
 
         new_units = []
-                
+
+        # UNITS ARE IMMUTABLE, ONLY THE LISTS ARE COPIED
         if left_units and right_units:
             if left_units == right_units:
                 # COPY EITHER ONE BECAUSE SAME
-                new_units = copy.deepcopy(left_units)
+                new_units = list(left_units)
             else:
-                new_units = copy.deepcopy(left_units)
+                # SET MEMBERSHIP BY BITMASK, ORDER OF THE LIST IS KEPT
+                unit_vocabulary = self.con.unit_vocabulary
+                new_units = list(left_units)
+                new_units_mask = unit_vocabulary.units_mask(left_units)
                 for r in right_units:
-                    if r not in new_units:
-                        new_units.append(copy.deepcopy(r))       
+                    r_bit = unit_vocabulary.unit_bit(r)
+                    if not (r_bit & new_units_mask):
+                        new_units.append(r)
+                        new_units_mask |= r_bit
         else:
             if left_units:
-                new_units = copy.deepcopy(left_units)
+                new_units = list(left_units)
             elif right_units:
-                new_units = copy.deepcopy(right_units)
+                new_units = list(right_units)
 
         return new_units
 
@@ -1664,15 +1982,17 @@ class TreeWalker:
         if self.perform_union_when_empty:
             if not (left_units and right_units):
                 if left_units:
-                    new_units = copy.deepcopy(left_units)
+                    new_units = list(left_units)
                 elif right_units:
-                    new_units = copy.deepcopy(right_units)
+                    new_units = list(right_units)
                 self.perform_union_when_empty = False
                 return new_units
                                  
+        unit_vocabulary = self.con.unit_vocabulary
+        left_units_mask = unit_vocabulary.units_mask(left_units)
         for r in right_units:
-            if r in left_units:
-                new_units.append(copy.deepcopy(r))
+            if unit_vocabulary.unit_bit(r) & left_units_mask:
+                new_units.append(r)
 
         self.perform_union_when_empty = False        
         return new_units
@@ -1680,9 +2000,13 @@ class TreeWalker:
 
     def update_units_from_to(self, from_token, to_token):
         is_updated = False
+        unit_vocabulary = self.con.unit_vocabulary
+        to_units_mask = unit_vocabulary.units_mask(to_token.units)
         for u in from_token.units:
-            if u not in to_token.units:
+            u_bit = unit_vocabulary.unit_bit(u)
+            if not (u_bit & to_units_mask):
                 to_token.units.append(u)
+                to_units_mask |= u_bit
                 self.was_some_unit_changed = True
                 is_updated = True
 
@@ -1888,22 +2212,8 @@ class TreeWalker:
             if not tw.found_units_in_this_tree:
                 break
             ### PROPAGATE UNITS
-            tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_across_dot_connectors)
-            tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_across_double_colon)                
-            tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_across_square_brackets)
-            tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_across_assignment)
-            tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_math_abs_fabs_floor_ceil)
-            tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_math_min_max)
-            tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_math_fmod_fmodf_fmodl)
-            tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_sqrt)
-            # tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_getXYZ)
-            tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_ternary)
-            tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_pow)
-            tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_inverse_trig)
-            tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_across_operators)
-            tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_across_return)
-            # tw.generic_recurse_and_apply_function(root_token, tw.collect_function_param_units_and_decorate_function)
-            tw.generic_recurse_and_apply_function(root_token, tw.propagate_units_across_parenthesis)
+            tw.propagate_units_one_round(root_token, 
+                                         skipped_rules=['collect_function_param_units_and_decorate_function'])
         # END -- WHILE LOOP 
 
 